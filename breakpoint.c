@@ -0,0 +1,268 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Breakpoint list kept sorted by address, so the entries of each page
+ * are contiguous and a lookup is a binary search over at most
+ * MAX_BREAKPOINTS entries. Watchpoints are few and carry qualifiers, so
+ * they live in a small unsorted table behind their own page bitmap.
+ */
+
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "breakpoint.h"
+#include "memory.h"
+
+// Global variables
+uint8_t breakpoint_pages[32];                // Page-presence bitmap
+static uint16_t breakpoints[MAX_BREAKPOINTS]; // Sorted breakpoint addresses
+static uint8_t breakpoint_count = 0;         // Number of breakpoints set
+
+typedef struct
+{
+    uint16_t address;
+    uint8_t flags; // WATCH_* qualifiers, 0 if the slot is free
+    uint8_t value; // Data value for WATCH_VALUE
+} watchpoint_t;
+
+uint8_t watchpoint_pages[32];                 // Page-presence bitmap
+static watchpoint_t watchpoints[MAX_WATCHPOINTS];
+
+/**
+ * Find the index of the first breakpoint at or above an address.
+ */
+static uint8_t lower_bound(uint16_t address)
+{
+    uint8_t low = 0;
+    uint8_t high = breakpoint_count;
+
+    while (low < high)
+    {
+        uint8_t middle = (low + high) >> 1;
+
+        if (breakpoints[middle] < address)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/**
+ * Recompute the page bit after a breakpoint was added or removed.
+ */
+static void update_page(uint8_t page)
+{
+    uint8_t index = lower_bound((uint16_t)page << 8);
+
+    if (index < breakpoint_count && (breakpoints[index] >> 8) == page)
+    {
+        breakpoint_pages[page >> 3] |= page_bit_mask[page & 7];
+    }
+    else
+    {
+        breakpoint_pages[page >> 3] &= ~page_bit_mask[page & 7];
+    }
+
+    // Breakpoint pages are served by the C bus service, which checks them
+    update_bus_page(page);
+}
+
+/**
+ * Add a breakpoint, keeping the list sorted.
+ * Returns 1 if successful (or already set), 0 if the list is full.
+ */
+uint8_t add_breakpoint(uint16_t address)
+{
+    uint8_t result = 1;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        uint8_t index = lower_bound(address);
+
+        if (index < breakpoint_count && breakpoints[index] == address)
+        {
+            // Already set
+        }
+        else if (breakpoint_count >= MAX_BREAKPOINTS)
+        {
+            result = 0;
+        }
+        else
+        {
+            for (uint8_t i = breakpoint_count; i > index; i--)
+            {
+                breakpoints[i] = breakpoints[i - 1];
+            }
+
+            breakpoints[index] = address;
+            breakpoint_count++;
+            update_page(address >> 8);
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Remove a breakpoint.
+ * Returns 1 if successful, 0 if no breakpoint was set at the address.
+ */
+uint8_t remove_breakpoint(uint16_t address)
+{
+    uint8_t result = 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        uint8_t index = lower_bound(address);
+
+        if (index < breakpoint_count && breakpoints[index] == address)
+        {
+            breakpoint_count--;
+
+            for (uint8_t i = index; i < breakpoint_count; i++)
+            {
+                breakpoints[i] = breakpoints[i + 1];
+            }
+
+            update_page(address >> 8);
+            result = 1;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Search the sorted list for a breakpoint at the given address.
+ * Returns 1 if found, 0 otherwise.
+ */
+uint8_t find_breakpoint(uint16_t address)
+{
+    uint8_t index = lower_bound(address);
+
+    return index < breakpoint_count && breakpoints[index] == address;
+}
+
+/**
+ * Recompute the watchpoint page bit after a watchpoint was added or removed.
+ */
+static void update_watch_page(uint8_t page)
+{
+    uint8_t present = 0;
+
+    for (uint8_t i = 0; i < MAX_WATCHPOINTS; i++)
+    {
+        if (watchpoints[i].flags && (watchpoints[i].address >> 8) == page)
+        {
+            present = 1;
+            break;
+        }
+    }
+
+    if (present)
+    {
+        watchpoint_pages[page >> 3] |= page_bit_mask[page & 7];
+    }
+    else
+    {
+        watchpoint_pages[page >> 3] &= ~page_bit_mask[page & 7];
+    }
+
+    update_bus_page(page);
+}
+
+/**
+ * Add or replace a watchpoint. Flags must select reads, writes or both.
+ * Returns 1 if successful, 0 if the flags are invalid or the table is full.
+ */
+uint8_t add_watchpoint(uint16_t address, uint8_t flags, uint8_t value)
+{
+    uint8_t result = 0;
+
+    if (!(flags & (WATCH_READ | WATCH_WRITE)))
+    {
+        return 0;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        watchpoint_t *slot = 0;
+
+        for (uint8_t i = 0; i < MAX_WATCHPOINTS; i++)
+        {
+            if (watchpoints[i].flags && watchpoints[i].address == address)
+            {
+                slot = &watchpoints[i]; // Replace the existing entry
+                break;
+            }
+
+            if (!watchpoints[i].flags && !slot)
+            {
+                slot = &watchpoints[i];
+            }
+        }
+
+        if (slot)
+        {
+            slot->address = address;
+            slot->flags = flags & (WATCH_READ | WATCH_WRITE | WATCH_VALUE);
+            slot->value = value;
+            update_watch_page(address >> 8);
+            result = 1;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Remove a watchpoint.
+ * Returns 1 if successful, 0 if no watchpoint was set at the address.
+ */
+uint8_t remove_watchpoint(uint16_t address)
+{
+    uint8_t result = 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        for (uint8_t i = 0; i < MAX_WATCHPOINTS; i++)
+        {
+            if (watchpoints[i].flags && watchpoints[i].address == address)
+            {
+                watchpoints[i].flags = 0;
+                update_watch_page(address >> 8);
+                result = 1;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Search for a watchpoint matching a data access.
+ * Access is WATCH_READ or WATCH_WRITE, data the byte transferred.
+ * Returns 1 if a watchpoint triggers, 0 otherwise.
+ */
+uint8_t find_watchpoint(uint16_t address, uint8_t access, uint8_t data)
+{
+    for (uint8_t i = 0; i < MAX_WATCHPOINTS; i++)
+    {
+        const watchpoint_t *watch = &watchpoints[i];
+
+        if ((watch->flags & access) && watch->address == address &&
+            (!(watch->flags & WATCH_VALUE) || watch->value == data))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
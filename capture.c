@@ -0,0 +1,117 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Logic-analyzer capture control and download.
+ */
+
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "capture.h"
+
+#define CAPTURE_MASK    (CAPTURE_SIZE - 1)
+
+// Global variables
+volatile uint8_t capture_state = CAPTURE_IDLE;
+uint16_t capture_address[CAPTURE_SIZE];     // Address of each sample
+uint8_t capture_data[CAPTURE_SIZE];         // Data transferred
+uint8_t capture_flags[CAPTURE_SIZE];        // CAPTURE_* flags
+uint8_t capture_head;                       // Next sample to write
+uint16_t capture_count;                     // Valid samples, up to CAPTURE_SIZE
+uint8_t capture_remaining;                  // Post-trigger samples still to record
+uint16_t capture_trigger;                   // Index of the trigger in the download
+uint16_t capture_low;                       // Trigger address range
+uint16_t capture_high;
+uint8_t capture_value;                      // Trigger data value and mask
+uint8_t capture_mask;
+uint8_t capture_access;                     // Trigger access qualifiers
+uint8_t capture_pre;                        // Pre-trigger depth
+
+/**
+ * Arm the capture. The trigger is the first cycle inside [low, high] with
+ * one of the access types in access (CAPTURE_READ, CAPTURE_WRITE, plus
+ * CAPTURE_SYNC to only consider opcode fetches) whose data matches value
+ * in the bits set in mask. Up to pre samples before the trigger and
+ * exactly post samples after it are kept.
+ * Returns 1 if successful, 0 if the settings are invalid.
+ */
+uint8_t arm_capture(uint16_t low, uint16_t high, uint8_t value, uint8_t mask,
+                    uint8_t access, uint8_t pre, uint8_t post)
+{
+    if (low > high || !(access & (CAPTURE_READ | CAPTURE_WRITE)) ||
+        (uint16_t)pre + post + 1 > CAPTURE_SIZE)
+    {
+        return 0;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        capture_low = low;
+        capture_high = high;
+        capture_value = value;
+        capture_mask = mask;
+        capture_access = access;
+        capture_pre = pre;
+        capture_remaining = post;
+        capture_head = 0;
+        capture_count = 0;
+        capture_state = CAPTURE_ARMED;
+    }
+
+    return 1;
+}
+
+/**
+ * Stop the capture and discard its samples.
+ */
+void disarm_capture(void)
+{
+    capture_state = CAPTURE_IDLE;
+}
+
+/**
+ * Return the size in bytes of the capture download.
+ */
+uint16_t capture_length(void)
+{
+    return CAPTURE_HEADER + 4 * capture_count;
+}
+
+/**
+ * Return one byte of the capture download (see capture.h for the
+ * layout). Only valid once the capture is complete.
+ */
+uint8_t capture_byte(uint16_t offset)
+{
+    uint8_t first = (capture_head - capture_count) & CAPTURE_MASK;
+
+    switch (offset)
+    {
+    case 0:
+        return capture_count >> 8;
+    case 1:
+        return capture_count & 0xFF;
+    case 2:
+        return capture_trigger >> 8;
+    case 3:
+        return capture_trigger & 0xFF;
+    }
+
+    offset -= CAPTURE_HEADER;
+
+    if (offset < 2 * capture_count)
+    {
+        uint16_t address = capture_address[(first + offset / 2) & CAPTURE_MASK];
+        return offset & 1 ? address & 0xFF : address >> 8;
+    }
+
+    offset -= 2 * capture_count;
+
+    if (offset < capture_count)
+    {
+        return capture_data[(first + offset) & CAPTURE_MASK];
+    }
+
+    offset -= capture_count;
+    return capture_flags[(first + offset) & CAPTURE_MASK];
+}
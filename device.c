@@ -0,0 +1,103 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Device registry and the dispatcher for pages shared by several devices.
+ */
+
+#include "device.h"
+
+// Global variables
+static const device_t *devices[DEVICE_MAX]; // In registration order
+static uint8_t device_count = 0;
+
+static uint8_t shared_read(uint16_t address);
+static void shared_write(uint16_t address, uint8_t data);
+
+static const io_handler_t shared_io = {shared_read, shared_write};
+
+/**
+ * Find the device decoding an address, or 0 if there is none.
+ */
+static const device_t *find_device(uint16_t address)
+{
+    for (uint8_t i = 0; i < device_count; i++)
+    {
+        if (address >= devices[i]->first && address <= devices[i]->last)
+        {
+            return devices[i];
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Read from a shared page. Gaps between devices read as 0xFF.
+ */
+static uint8_t shared_read(uint16_t address)
+{
+    const device_t *device = find_device(address);
+
+    return device ? device->io.read(address) : 0xFF;
+}
+
+/**
+ * Write to a shared page. Writes to gaps between devices are ignored.
+ */
+static void shared_write(uint16_t address, uint8_t data)
+{
+    const device_t *device = find_device(address);
+
+    if (device)
+    {
+        device->io.write(address, data);
+    }
+}
+
+/**
+ * Add a device to the 6502 address space. Its pages must be unmapped or
+ * hold other devices, and its range must not overlap theirs. The device
+ * is kept by reference, so it must stay valid (normally a const global).
+ * I/O pages should only be set up through here: a page already holding
+ * an I/O handler is assumed to hold a registered device.
+ * Returns 1 if successful, 0 if the range is invalid, taken or the
+ * registry is full.
+ */
+uint8_t register_device(const device_t *device)
+{
+    uint8_t first_page = device->first >> 8;
+    uint8_t last_page = device->last >> 8;
+    uint8_t page = first_page;
+
+    if (device_count == DEVICE_MAX || device->last < device->first)
+    {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < device_count; i++)
+    {
+        if (device->first <= devices[i]->last && device->last >= devices[i]->first)
+        {
+            return 0;
+        }
+    }
+
+    do
+    {
+        if (page_type[page] != PAGE_UNMAPPED && page_type[page] != PAGE_IO)
+        {
+            return 0;
+        }
+    } while (page++ != last_page);
+
+    devices[device_count++] = device;
+
+    // A page the device has to itself dispatches straight to it
+    page = first_page;
+    do
+    {
+        map_io(page, 1, page_type[page] == PAGE_IO ? &shared_io : &device->io);
+    } while (page++ != last_page);
+
+    return 1;
+}
@@ -0,0 +1,80 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Breakpoint and watchpoint storage. A 256-bit page bitmap answers the
+ * common "nothing in this page" case with one bit test; only pages whose
+ * bit is set search the address lists.
+ *
+ * Execution breakpoints are tested on opcode fetches (SYNC high) only.
+ * Watchpoints are tested on every other cycle and can be qualified by
+ * access direction and data value.
+ */
+
+#ifndef BREAKPOINT_H
+#define BREAKPOINT_H
+
+#include <stdint.h>
+
+#include "memory.h"
+
+// Breakpoint definitions
+#define MAX_BREAKPOINTS 64 // Maximum number of breakpoints
+#define MAX_WATCHPOINTS 16 // Maximum number of watchpoints
+
+// Watchpoint qualifiers
+#define WATCH_READ      0x01 // Trigger on 6502 reads
+#define WATCH_WRITE     0x02 // Trigger on 6502 writes
+#define WATCH_VALUE     0x04 // Trigger only if the data matches the value
+
+// Kinds of hits reported to the host
+#define HIT_BREAKPOINT  1
+#define HIT_WATCH_READ  2
+#define HIT_WATCH_WRITE 3
+
+// Page-presence bitmaps, one bit per 256-byte page
+extern uint8_t breakpoint_pages[32];
+extern uint8_t watchpoint_pages[32];
+
+// Function prototypes
+uint8_t add_breakpoint(uint16_t address);
+uint8_t remove_breakpoint(uint16_t address);
+uint8_t find_breakpoint(uint16_t address);
+uint8_t add_watchpoint(uint16_t address, uint8_t flags, uint8_t value);
+uint8_t remove_watchpoint(uint16_t address);
+uint8_t find_watchpoint(uint16_t address, uint8_t access, uint8_t data);
+
+/**
+ * Check whether any breakpoint lies in the given page.
+ */
+static inline uint8_t breakpoint_in_page(uint8_t page)
+{
+    return breakpoint_pages[page >> 3] & page_bit_mask[page & 7];
+}
+
+/**
+ * Check whether any watchpoint lies in the given page.
+ */
+static inline uint8_t watchpoint_in_page(uint8_t page)
+{
+    return watchpoint_pages[page >> 3] & page_bit_mask[page & 7];
+}
+
+/**
+ * Check whether a breakpoint is set at the given address.
+ * Costs a single bit test unless the page holds a breakpoint.
+ */
+static inline uint8_t check_breakpoint(uint16_t address)
+{
+    return breakpoint_in_page(address >> 8) && find_breakpoint(address);
+}
+
+/**
+ * Check whether a data access triggers a watchpoint.
+ * Costs a single bit test unless the page holds a watchpoint.
+ */
+static inline uint8_t check_watchpoint(uint16_t address, uint8_t access, uint8_t data)
+{
+    return watchpoint_in_page(address >> 8) && find_watchpoint(address, access, data);
+}
+
+#endif // BREAKPOINT_H
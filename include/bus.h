@@ -0,0 +1,52 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Interface to the hand-scheduled assembly bus loop (bus.S).
+ * This header is included from assembly, so C declarations are guarded.
+ */
+
+#ifndef BUS_H
+#define BUS_H
+
+#include "pins.h"
+
+// Assembly bus loop timing, see bus.S for the cycle-by-cycle schedule
+#define BUS_ASM_CYCLES  20                       // AVR cycles per PHI2 cycle
+#define BUS_ASM_HZ      (F_CPU / BUS_ASM_CYCLES) // Free-running PHI2 frequency
+#define BUS_ASM_ROM_CYCLES 28                    // AVR cycles per ROM read cycle
+#ifdef XMEM_SIZE_KB
+#define BUS_ASM_WRITE_CYCLES 21                  // External SRAM store plus the write count
+#else
+#define BUS_ASM_WRITE_CYCLES BUS_ASM_CYCLES
+#endif
+
+#ifndef __ASSEMBLER__
+
+#include <stdint.h>
+
+// Fast-path page map for bus.S, kept in sync with the page table by
+// memory.c: the SRAM high byte of each RAM page, 0 for any page that
+// needs the C bus service. 256-byte aligned so bus.S indexes it directly.
+extern uint8_t bus_page_map[256];
+
+// Same for writes, except that pages not marked dirty are also 0, so the
+// first write to a clean page reaches bus_write() and marks it.
+extern uint8_t bus_write_map[256];
+
+// Read fast path for ROM pages: the flash high byte of each page bus.S
+// serves with LPM, 0 for any other page. Only consulted when
+// bus_page_map has 0 for the page.
+extern uint8_t bus_rom_map[256];
+
+// Clock and service the given number of PHI2 cycles (0 means 256).
+// Returns 0 when done. If it stopped with PHI2 high on a page that needs
+// the C bus service, returns the cycles left including that one (1 or
+// more); the caller must then finish that cycle. With 0 (256) cycles a
+// hand-over on the first cycle also returns 0, so callers that need to
+// tell it apart pass at most 255. Stores in writes how many of the
+// cycles it served were writes; the rest were reads.
+uint8_t bus_run(uint8_t cycles, uint8_t *writes);
+
+#endif // __ASSEMBLER__
+
+#endif // BUS_H
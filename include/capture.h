@@ -0,0 +1,115 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Logic-analyzer capture. Once armed, every bus cycle (address, data,
+ * R/W, SYNC) is recorded into a ring buffer until the trigger fires;
+ * then the pre-trigger depth is kept and the post-trigger samples are
+ * recorded, after which the capture stops and the host downloads it
+ * with 'Y' as one block:
+ *
+ *   count (2) | trigger index (2) | address[count] (2 each) |
+ *   data[count] | flags[count]
+ *
+ * with all multi-byte values big-endian, oldest sample first.
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+
+// Capture depth, a power of two no larger than 256, at 4 bytes of SRAM
+// per sample: 32 samples (128 bytes) next to the 6502 RAM of the
+// internal build, 256 (1KB) once XMEM builds move that RAM off-chip.
+#ifdef XMEM_SIZE_KB
+#define CAPTURE_SIZE    256
+#else
+#define CAPTURE_SIZE    32
+#endif
+#define CAPTURE_HEADER  4  // Count and trigger index
+
+// Sample flags, also used as trigger access qualifiers
+#define CAPTURE_READ    0x01 // R/W high
+#define CAPTURE_WRITE   0x02 // R/W low
+#define CAPTURE_SYNC    0x04 // Opcode fetch (trigger on fetches only)
+
+// Capture states
+#define CAPTURE_IDLE    0
+#define CAPTURE_ARMED   1 // Recording, waiting for the trigger
+#define CAPTURE_POST    2 // Triggered, recording post-trigger samples
+#define CAPTURE_DONE    3 // Complete, not reported to the host yet
+#define CAPTURE_READY   4 // Complete and reported
+
+// Capture buffer and trigger, one array per field
+extern volatile uint8_t capture_state;
+extern uint16_t capture_address[CAPTURE_SIZE];
+extern uint8_t capture_data[CAPTURE_SIZE];
+extern uint8_t capture_flags[CAPTURE_SIZE];
+extern uint8_t capture_head;
+extern uint16_t capture_count;
+extern uint8_t capture_remaining;
+extern uint16_t capture_trigger;
+extern uint16_t capture_low;
+extern uint16_t capture_high;
+extern uint8_t capture_value;
+extern uint8_t capture_mask;
+extern uint8_t capture_access;
+extern uint8_t capture_pre;
+
+// Function prototypes
+uint8_t arm_capture(uint16_t low, uint16_t high, uint8_t value, uint8_t mask,
+                    uint8_t access, uint8_t pre, uint8_t post);
+void disarm_capture(void);
+uint16_t capture_length(void);
+uint8_t capture_byte(uint16_t offset);
+
+/**
+ * Check whether the capture is recording bus cycles.
+ */
+static inline uint8_t capture_recording(void)
+{
+    return capture_state == CAPTURE_ARMED || capture_state == CAPTURE_POST;
+}
+
+/**
+ * Record one bus cycle and advance the trigger state.
+ * Called by the bus service while capture_recording() is true.
+ */
+static inline void record_capture(uint16_t address, uint8_t data, uint8_t flags)
+{
+    uint8_t i = capture_head;
+
+    capture_address[i] = address;
+    capture_data[i] = data;
+    capture_flags[i] = flags;
+    capture_head = (i + 1) & (CAPTURE_SIZE - 1);
+
+    if (capture_count < CAPTURE_SIZE)
+    {
+        capture_count++;
+    }
+
+    if (capture_state == CAPTURE_ARMED)
+    {
+        if (address >= capture_low && address <= capture_high &&
+            (flags & capture_access & (CAPTURE_READ | CAPTURE_WRITE)) &&
+            (flags & CAPTURE_SYNC) >= (capture_access & CAPTURE_SYNC) &&
+            !((data ^ capture_value) & capture_mask))
+        {
+            // Keep only the pre-trigger depth before the trigger
+            if (capture_count > capture_pre + 1)
+            {
+                capture_count = capture_pre + 1;
+            }
+
+            capture_trigger = capture_count - 1;
+            capture_state = capture_remaining ? CAPTURE_POST : CAPTURE_DONE;
+        }
+    }
+    else if (--capture_remaining == 0)
+    {
+        capture_state = CAPTURE_DONE;
+    }
+}
+
+#endif // CAPTURE_H
@@ -0,0 +1,28 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * CPU control and run-mode clock, implemented in main.c and shared with
+ * the host protocol handlers.
+ */
+
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+
+// CPU state
+extern volatile uint8_t cpu_running;
+extern uint32_t clock_frequency; // Run-mode PHI2 frequency (Hz), 0 when free-running
+extern volatile uint32_t cycle_count; // PHI2 cycles clocked since power-on
+extern volatile uint8_t breakpoint_hit; // HIT_* kind waiting to be reported
+
+// Function prototypes
+uint8_t set_clock_frequency(uint32_t frequency);
+void reset_cpu(void);
+void halt_cpu(void);
+void release_cpu(void);
+void step_cpu(void);
+void bus_cycle(void);
+uint8_t bus_loop_bypassed(void);
+
+#endif // CPU_H
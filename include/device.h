@@ -0,0 +1,35 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Memory-mapped peripherals. A device declares an address range and its
+ * read/write handlers, and register_device() points the page table at
+ * it. The bus service then reaches it with the same page lookup and
+ * indirect call as any I/O page; RAM and ROM pages are left alone.
+ *
+ * A device alone on a page is called straight from the page table for
+ * every address of that page, so its handlers decode their own range
+ * (reads outside it return 0xFF, writes are ignored), like partial
+ * address decoding in hardware. Only pages shared by several devices
+ * pay for a range check, through a dispatcher that finds the device.
+ */
+
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#include <stdint.h>
+
+#include "memory.h"
+
+#define DEVICE_MAX      8 // Registered devices
+
+typedef struct
+{
+    io_handler_t io; // First, so a page can point straight at the device
+    uint16_t first;  // Address range, inclusive
+    uint16_t last;
+} device_t;
+
+// Function prototypes
+uint8_t register_device(const device_t *device);
+
+#endif // DEVICE_H
@@ -0,0 +1,120 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * IRQ/NMI generator. Each line can be fired once, periodically every N
+ * 6502 cycles, or whenever the 6502 accesses a chosen address:
+ *
+ *   IRQ  pulled low and held until the 6502 acknowledges it by writing
+ *        bit 0 of the status register
+ *   NMI  pulled low until the 6502 fetches the NMI vector, one edge
+ *
+ * Periodic deadlines are kept in cycles of the cycle counter and move on
+ * by exactly one period each time, so the interval is exact and does not
+ * depend on the clock engine. The status register is mapped at $D100:
+ *
+ *   read   bit 0 IRQ asserted, bit 1 NMI asserted
+ *   write  bit 0 set acknowledges (releases) the IRQ
+ */
+
+#ifndef IRQ_H
+#define IRQ_H
+
+#include <stdint.h>
+
+#include "pins.h"
+#include "cpu.h"
+#include "device.h"
+
+// Status register location
+#define IRQ_STATUS      0xD100
+
+// Low byte of the NMI vector, whose fetch releases NMI
+#define NMI_VECTOR      0xFFFA
+
+// Lines
+#define LINE_IRQ        0
+#define LINE_NMI        1
+
+// 'i' modes
+#define GEN_OFF         0 // Stop the generator and release the line
+#define GEN_ONCE        1 // Fire now
+#define GEN_PERIODIC    2 // Argument: period in cycles
+#define GEN_ADDRESS     3 // Argument: address whose access fires the line
+
+// Status register bits
+#define IRQ_ASSERTED    0x01
+#define NMI_ASSERTED    0x02
+
+// Active generator bits, by line
+#define GEN_PERIODIC_IRQ 0x01
+#define GEN_PERIODIC_NMI 0x02
+#define GEN_ADDRESS_IRQ  0x04
+#define GEN_ADDRESS_NMI  0x08
+#define GEN_PERIODIC_ANY (GEN_PERIODIC_IRQ | GEN_PERIODIC_NMI)
+#define GEN_ADDRESS_ANY  (GEN_ADDRESS_IRQ | GEN_ADDRESS_NMI)
+#define GEN_NMI_ANY      (GEN_PERIODIC_NMI | GEN_ADDRESS_NMI)
+#define GEN_IRQ_HELD     0x80 // suspend_generator() state: IRQ was asserted
+
+// Generator state
+extern volatile uint8_t generator_active;   // GEN_PERIODIC_* and GEN_ADDRESS_* bits
+extern uint32_t generator_period[2];
+extern uint32_t generator_deadline[2];       // Cycle counter value of the next firing
+extern uint16_t generator_address[2];
+
+// Device registered at the status register
+extern const device_t irq_device;
+
+// Function prototypes
+uint8_t set_generator(uint8_t line, uint8_t mode, uint32_t argument);
+void fire_line(uint8_t line);
+void check_generator(void);
+uint8_t generator_burst(uint8_t cycles);
+uint8_t suspend_generator(uint8_t *state);
+void resume_generator(uint8_t state);
+void reset_generator(void);
+
+/**
+ * Fire a line whose generator watches this address. Called by the bus
+ * service on every access while an address generator is active.
+ */
+static inline void check_generator_address(uint16_t address)
+{
+    if ((generator_active & GEN_ADDRESS_IRQ) && address == generator_address[LINE_IRQ])
+    {
+        fire_line(LINE_IRQ);
+    }
+
+    if ((generator_active & GEN_ADDRESS_NMI) && address == generator_address[LINE_NMI])
+    {
+        fire_line(LINE_NMI);
+    }
+}
+
+/**
+ * Release NMI once the 6502 has taken it. Called by the bus service when
+ * the NMI vector is fetched.
+ */
+static inline void release_nmi(void)
+{
+    CONTROL_PORT |= (1 << CPU_NMI);
+
+    if (!(generator_active & GEN_NMI_ANY))
+    {
+        update_bus_page(NMI_VECTOR >> 8); // bus.S may serve the vectors again
+    }
+}
+
+/**
+ * Check whether the generator needs the C bus service for a page: the
+ * page of a watched address, and the vector page while NMI may be low,
+ * as only the C service sees the vector fetch that releases it.
+ */
+static inline uint8_t generator_in_page(uint8_t page)
+{
+    return ((generator_active & GEN_ADDRESS_IRQ) && (generator_address[LINE_IRQ] >> 8) == page) ||
+           ((generator_active & GEN_ADDRESS_NMI) && (generator_address[LINE_NMI] >> 8) == page) ||
+           (page == (NMI_VECTOR >> 8) &&
+            ((generator_active & GEN_NMI_ANY) || !(CONTROL_PORT & (1 << CPU_NMI))));
+}
+
+#endif // IRQ_H
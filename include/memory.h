@@ -0,0 +1,149 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Page-based address decoding. The 6502 address space is split into
+ * 256 pages of 256 bytes, and each page is described by a type and a
+ * base pointer indexed by the address high byte.
+ */
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#include "stats.h"
+
+// Memory definitions
+#if XMEM_SIZE_KB == 64
+// 64 KB chip on the full XMEM bus. Internal SRAM shadows the chip below
+// 0x2200, so 6502 $0000-$CFFF (everything below I/O and ROM) is backed
+// by AVR addresses 0x2200-0xF1FF
+#define MEMORY_SIZE     0xD000
+#define MEMORY_BASE     ((uint8_t *)0x2200)
+#elif XMEM_SIZE_KB == 32
+// 32 KB chip with PC7 (A15) released; AVR addresses 0x8000-0xFFFF
+// reach the whole chip and back 6502 $0000-$7FFF
+#define MEMORY_SIZE     0x8000
+#define MEMORY_BASE     ((uint8_t *)0x8000)
+#elif defined(XMEM_SIZE_KB)
+#error "XMEM_SIZE_KB must be 32 or 64"
+#else
+#define MEMORY_SIZE     4096 // 4KB of memory, must be a multiple of 256
+#define MEMORY_BASE     memory
+#endif
+
+// Page types
+#define PAGE_UNMAPPED   0 // Reads as 0xFF, writes are ignored
+#define PAGE_RAM        1 // Read/write, backed by SRAM
+#define PAGE_ROM        2 // Read-only, served from PROGMEM
+#define PAGE_IO         3 // Dispatched to an I/O handler
+
+// I/O handlers receive the full 6502 address
+typedef uint8_t (*io_read_handler)(uint16_t address);
+typedef void (*io_write_handler)(uint16_t address, uint8_t data);
+
+typedef struct
+{
+    io_read_handler read;
+    io_write_handler write;
+} io_handler_t;
+
+// Page base: where offset 0 of the page lives, depending on its type
+typedef union
+{
+    uint8_t *ram;
+    const uint8_t *rom;
+    const io_handler_t *io;
+} page_base_t;
+
+// Page table, indexed by the address high byte
+extern uint8_t page_type[256];
+extern page_base_t page_base[256];
+
+// Pages written since the host last fetched them, one bit per page
+extern uint8_t dirty_pages[32];
+extern const uint8_t page_bit_mask[8];
+
+#ifndef XMEM_SIZE_KB
+// Simulated memory
+extern uint8_t memory[MEMORY_SIZE];
+#endif
+
+// Function prototypes
+uint8_t init_memory_map(void);
+void map_ram(uint8_t first_page, uint8_t pages, uint8_t *ram);
+void map_rom(uint8_t first_page, uint8_t pages, const uint8_t *rom);
+void map_io(uint8_t first_page, uint8_t pages, const io_handler_t *io);
+void unmap_pages(uint8_t first_page, uint8_t pages);
+void update_bus_page(uint8_t page);
+void mark_page_dirty(uint8_t page);
+void take_dirty_pages(uint8_t *pages);
+uint8_t write_memory(uint16_t address, uint8_t data);
+uint8_t read_memory(uint16_t address, uint8_t *data);
+uint8_t pages_readable(uint8_t first_page, uint8_t pages);
+uint16_t calculate_checksum(const uint8_t *data, uint16_t length);
+uint8_t hash_page(uint8_t page, uint16_t *hash);
+
+/**
+ * Check whether a page has been written since the last fetch.
+ */
+static inline uint8_t page_dirty(uint8_t page)
+{
+    return dirty_pages[page >> 3] & page_bit_mask[page & 7];
+}
+
+/**
+ * Read a byte for the 6502. RAM costs one indexed load plus one
+ * pointer add; there is no bounds check on the per-cycle path.
+ */
+static inline uint8_t bus_read(uint16_t address)
+{
+    uint8_t page = address >> 8;
+    uint8_t offset = address & 0xFF;
+
+    switch (page_type[page])
+    {
+    case PAGE_RAM:
+        return page_base[page].ram[offset];
+    case PAGE_ROM:
+        return pgm_read_byte(page_base[page].rom + offset);
+    case PAGE_IO:
+        return page_base[page].io->read(address);
+    default:
+        stats[STAT_UNMAPPED]++;
+        return 0xFF;
+    }
+}
+
+/**
+ * Write a byte from the 6502. Writes to ROM or unmapped pages are ignored.
+ * The first write to a clean RAM page marks it dirty.
+ */
+static inline void bus_write(uint16_t address, uint8_t data)
+{
+    uint8_t page = address >> 8;
+    uint8_t offset = address & 0xFF;
+
+    switch (page_type[page])
+    {
+    case PAGE_RAM:
+        page_base[page].ram[offset] = data;
+
+        if (!page_dirty(page))
+        {
+            mark_page_dirty(page);
+        }
+        break;
+    case PAGE_IO:
+        page_base[page].io->write(address, data);
+        break;
+    case PAGE_UNMAPPED:
+        stats[STAT_UNMAPPED]++;
+        break;
+    default:
+        break;
+    }
+}
+
+#endif // MEMORY_H
@@ -0,0 +1,40 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Motorola 6821 PIA as wired in the Apple-1, mapped at $D010-$D013:
+ *
+ *   $D010  KBD    keyboard data, bit 7 always set
+ *   $D011  KBDCR  keyboard control, bit 7 set while a key is waiting
+ *   $D012  DSP    display data, bit 7 set while the display is busy
+ *   $D013  DSPCR  display control
+ *
+ * The keyboard is a FIFO fed by the host ('K'), the display a FIFO
+ * drained to the host by the main loop. The handshake bits follow the
+ * FIFOs, so the 6502 only waits while the link is really behind.
+ */
+
+#ifndef PIA_H
+#define PIA_H
+
+#include <stdint.h>
+
+#include "device.h"
+
+// PIA location
+#define PIA_BASE        0xD010
+#define PIA_LAST        0xD013
+
+// FIFO sizes, must be powers of two no larger than 256
+#define KEYBOARD_SIZE   16
+#define DISPLAY_SIZE    16
+
+// Device registered at $D010-$D013
+extern const device_t pia_device;
+
+// Function prototypes
+void reset_pia(void);
+uint8_t pia_key(uint8_t key);
+uint8_t display_available(void);
+uint8_t display_read(void);
+
+#endif // PIA_H
@@ -0,0 +1,51 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Pin and port assignments shared by the C firmware and the assembly
+ * bus loop. Only preprocessor definitions belong here.
+ */
+
+#ifndef PINS_H
+#define PINS_H
+
+#include <avr/io.h>
+
+// Define CPU control pins
+#define CPU_RESET       PD0
+#define CPU_RW          PD1
+#define CPU_IRQ         PD2
+#define CPU_NMI         PD3
+#define CPU_SYNC        PD4
+#define CPU_CLOCK       PD5
+
+#ifdef XMEM_SIZE_KB
+
+// The external memory interface owns PORTA (AD7..0), PORTC (A15..8) and
+// PG0..2 (WR, RD, ALE), so the 6502 buses move to ports that stay in
+// I/O space and keep the assembly bus loop timing unchanged
+#define DATA_BUS        PORTF
+#define DATA_DIR        DDRF
+#define DATA_PIN        PINF
+
+#define ADDR_BUS_LOW    PINB // Lower 8 bits
+#define ADDR_BUS_HIGH   PINL // Higher 8 bits
+
+#else
+
+// Define data bus port (e.g., PORTA)
+#define DATA_BUS        PORTA
+#define DATA_DIR        DDRA
+#define DATA_PIN        PINA
+
+// Define address bus ports (e.g., PORTC and PORTL for 16 bits)
+#define ADDR_BUS_LOW    PINC // Lower 8 bits
+#define ADDR_BUS_HIGH   PINL // Higher 8 bits
+
+#endif // XMEM_SIZE_KB
+
+// Define control signals
+#define CONTROL_PORT    PORTD
+#define CONTROL_DIR     DDRD
+#define CONTROL_PIN     PIND
+
+#endif // PINS_H
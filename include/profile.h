@@ -0,0 +1,97 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Sampled PC profiler. While running, the opcode-fetch address (SYNC
+ * high) is sampled either every Nth instruction or on the first fetch
+ * after every N cycles, and binned into a histogram of PROFILE_BUCKETS
+ * buckets of 2^shift bytes starting at a base address. Samples outside
+ * that window only count towards the total.
+ *
+ * Overhead is bounded per opcode fetch, in the C bus service only: a
+ * countdown or a 16-bit cycle compare on every fetch, plus a subtract,
+ * shift and saturating increment on each sample. In assembly bus loop
+ * builds the 6502 is clocked through the C bus service while profiling.
+ *
+ * The histogram is downloaded with 'p' as one block:
+ *
+ *   base (2) | shift | mode | samples (4) | count[PROFILE_BUCKETS] (2 each)
+ *
+ * with all multi-byte values big-endian. Bucket counts saturate at 65535.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+#include "cpu.h"
+
+// Histogram size, 2 bytes of SRAM per bucket. The internal build shares
+// SRAM with the 4KB of 6502 RAM and keeps 64 buckets (128 bytes), 1KB
+// each at the largest shift. XMEM builds have room for 1024 (2KB), which
+// cover the address space in 64-byte buckets.
+#ifdef XMEM_SIZE_KB
+#define PROFILE_BUCKETS 1024
+#else
+#define PROFILE_BUCKETS 64
+#endif
+#define PROFILE_HEADER  8  // Base, shift, mode and sample count
+#define PROFILE_MAX_SHIFT 10
+
+// 'p' modes
+#define PROFILE_STOP            0
+#define PROFILE_INSTRUCTIONS    1 // Sample every Nth instruction, clears the histogram
+#define PROFILE_CYCLES          2 // Sample after every N cycles, clears the histogram
+#define PROFILE_READ            3 // Stops sampling and downloads the histogram
+
+// Profiler state
+extern volatile uint8_t profile_mode;   // PROFILE_STOP while not sampling
+extern uint16_t profile_counts[PROFILE_BUCKETS];
+extern uint32_t profile_samples;
+extern uint16_t profile_base;
+extern uint8_t profile_shift;
+extern uint16_t profile_period;
+extern uint16_t profile_next;           // Countdown, or cycle of the next sample
+
+// Function prototypes
+uint8_t start_profile(uint8_t mode, uint16_t base, uint8_t shift, uint16_t period);
+void stop_profile(void);
+uint16_t profile_length(void);
+uint8_t profile_byte(uint16_t offset);
+
+/**
+ * Sample an opcode fetch if it is due. Called by the bus service when
+ * SYNC is high and the profiler is running.
+ */
+static inline void record_profile(uint16_t address)
+{
+    if (profile_mode == PROFILE_INSTRUCTIONS)
+    {
+        if (--profile_next)
+        {
+            return;
+        }
+        profile_next = profile_period;
+    }
+    else
+    {
+        uint16_t now = (uint16_t)cycle_count;
+
+        if ((int16_t)(now - profile_next) < 0)
+        {
+            return;
+        }
+        profile_next = now + profile_period;
+    }
+
+    profile_samples++;
+
+    uint16_t bucket = (uint16_t)(address - profile_base) >> profile_shift;
+
+    if (bucket < PROFILE_BUCKETS && profile_counts[bucket] != 0xFFFF)
+    {
+        profile_counts[bucket]++;
+    }
+}
+
+#endif // PROFILE_H
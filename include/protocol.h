@@ -0,0 +1,78 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Framed binary protocol (v2). Every frame is
+ *
+ *   SOF | LEN | SEQ | CMD/STATUS | PAYLOAD[LEN] | CRC16 (big-endian)
+ *
+ * with the CRC-16/XMODEM computed over LEN through the end of the
+ * payload. Requests carry a command byte, responses echo the request's
+ * SEQ and carry a status byte instead. Unsolicited events (breakpoint
+ * and watchpoint hits) use SEQ 0 and STATUS_EVENT. Block dumps ('X',
+ * 'U', 'T', 'Y', 'p' and 'Q') are answered with STATUS_MORE data frames and a
+ * final STATUS_OK frame carrying the CRC of all the data.
+ *
+ * Command bytes are the legacy command letters, with binary payloads
+ * instead of ASCII replies. The legacy protocol stays the default;
+ * the 'P' command switches between the two.
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+
+// Frame definitions
+#define FRAME_SOF           0xA5 // Start of frame
+#define FRAME_MAX_PAYLOAD   128  // Longest request payload accepted
+#define FRAME_OVERHEAD      6    // SOF, LEN, SEQ, status and CRC bytes
+
+// Block dumps are streamed in chunks of this many bytes
+#define DUMP_CHUNK          64
+
+// Page hashes are computed while streaming, this many bytes per chunk
+#define HASH_CHUNK          8
+
+// Protocol modes, selected with 'P'
+#define PROTOCOL_LEGACY     0
+#define PROTOCOL_FRAMED     1
+
+// Response status codes
+#define STATUS_OK               0x00
+#define STATUS_BAD_CRC          0x01
+#define STATUS_UNKNOWN_COMMAND  0x02
+#define STATUS_BAD_LENGTH       0x03
+#define STATUS_INVALID_ADDRESS  0x04
+#define STATUS_INVALID_ARGUMENT 0x05
+#define STATUS_FULL             0x06
+#define STATUS_NOT_FOUND        0x07
+#define STATUS_UNSUPPORTED      0x08
+#define STATUS_MORE             0x09 // Data chunk, more frames follow
+#define STATUS_BUSY             0x0A
+#define STATUS_EVENT            0x80
+
+// Event kinds besides the HIT_* codes
+#define EVENT_DISPLAY           0x10 // Characters written to the PIA display
+#define EVENT_CAPTURE           0x11 // Logic-analyzer capture complete
+
+// Current protocol mode
+extern uint8_t protocol_mode;
+
+// Set while a block dump is being streamed
+extern uint8_t dump_active;
+
+// Function prototypes
+void handle_frame_input(void);
+void frame_begin(uint8_t seq, uint8_t status, uint8_t length);
+void frame_byte(uint8_t data);
+void frame_end(void);
+void send_frame(uint8_t seq, uint8_t status, const uint8_t *payload, uint8_t length);
+uint8_t start_dump(uint16_t address, uint16_t length, uint8_t seq);
+void start_dirty_dump(uint8_t seq);
+void start_trace_dump(uint8_t seq);
+void start_capture_dump(uint8_t seq);
+void start_profile_dump(uint8_t seq);
+void start_hash_dump(uint8_t first_page, uint8_t pages, uint8_t seq);
+void continue_dump(void);
+
+#endif // PROTOCOL_H
@@ -0,0 +1,44 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Register access by opcode injection. With the CPU halted at an
+ * instruction boundary, the AVR answers the next opcode fetch with a
+ * short stub instead of memory and clocks it by hand:
+ *
+ *   read:   PHP, PLP, STA, STX, STY, JMP back to the PC
+ *   write:  LDX #SP-1, TXS, LDA, LDX, LDY, PLP, JMP to the new PC
+ *
+ * The stub's writes are snooped from the bus and never stored, and its
+ * stack pull is answered with the flags, so user memory is untouched.
+ * The CPU is left halted before the next opcode fetch.
+ */
+
+#ifndef REGISTERS_H
+#define REGISTERS_H
+
+#include <stdint.h>
+
+// Addresses the read stub stores A, X and Y to; only seen on the bus
+#define SNOOP_A         0x0000
+#define SNOOP_X         0x0001
+#define SNOOP_Y         0x0002
+
+// Bounds on the injection, in PHI2 cycles
+#define INJECT_MAX_WAIT     16 // To reach the next opcode fetch
+#define INJECT_MAX_CYCLES   32 // To run a stub
+
+typedef struct
+{
+    uint8_t a;
+    uint8_t x;
+    uint8_t y;
+    uint8_t sp;
+    uint8_t p;
+    uint16_t pc;
+} registers_t;
+
+// Function prototypes
+uint8_t read_registers(registers_t *registers);
+uint8_t write_registers(const registers_t *registers);
+
+#endif // REGISTERS_H
@@ -0,0 +1,56 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Batched stepping: step N instructions, run until an address, step over
+ * a JSR and step out of a subroutine, all clocked on the AVR by the main
+ * loop a few instructions per pass, with one result sent at the end.
+ *
+ * Calls are followed by opcode: JSR and BRK (and interrupts, recognized
+ * by the cycle after the fetch re-reading its address) go one level
+ * deeper, RTS and RTI one level back. Step over is step out started
+ * from the JSR; it stops when its matching return has executed, so it
+ * does not depend on the return address.
+ *
+ * The result is the stop reason, the PC (2) and the number of
+ * instructions run (4), big-endian. A breakpoint or watchpoint hit ends
+ * the run with STOP_HIT and is also reported as usual.
+ */
+
+#ifndef RUN_H
+#define RUN_H
+
+#include <stdint.h>
+
+// 's' modes
+#define RUN_STEPS       0 // Argument: instruction count, 0 for 65536
+#define RUN_UNTIL       1 // Argument: address of the opcode fetch to stop before
+#define RUN_OVER        2 // Run a JSR or BRK through its return, else one step
+#define RUN_OUT         3 // Run until the current subroutine returns
+
+// Stop reasons
+#define STOP_DONE       0
+#define STOP_HIT        1 // Breakpoint or watchpoint
+#define STOP_HALTED     2 // Cancelled by the host ('H', 'C', 'R' or 'S')
+
+// Run states
+#define RUN_IDLE        0
+#define RUN_ACTIVE      1
+#define RUN_DONE        2 // Finished, result not sent yet
+
+#define RUN_BURST       64 // Instructions per main loop pass
+#define RUN_RESULT      7  // Result length
+
+// Run state and result
+extern uint8_t run_state;
+extern uint8_t run_seq;                 // Request SEQ, for the framed result
+extern uint8_t run_reason;              // STOP_* once done
+extern uint16_t run_pc;                 // PC at the stop
+extern uint32_t run_count;              // Instructions run
+
+// Function prototypes
+uint8_t start_run(uint8_t mode, uint16_t argument, uint8_t seq);
+void continue_run(void);
+void cancel_run(void);
+void run_result(uint8_t *result);
+
+#endif // RUN_H
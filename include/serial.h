@@ -0,0 +1,39 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Interrupt-driven USART0 link to the PC. Received bytes and bytes to
+ * send are queued in SRAM ring buffers, so the bus service never waits
+ * on the serial port.
+ */
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+
+// Ring buffer sizes, must be powers of two no larger than 256
+#define SERIAL_RX_SIZE  64
+#define SERIAL_TX_SIZE  128
+
+// Baud rate negotiation
+#define BAUD_MAX_ERROR      2    // Largest accepted baud rate error (%)
+#define BAUD_CONFIRM_MS     2000 // Host must confirm within this time after a switch
+#define BAUD_CONFIRM_BYTE   0x55 // Sent by the host at the new rate to confirm it
+
+// Function prototypes
+void init_serial(uint32_t baud_rate);
+uint8_t baud_rate_supported(uint32_t baud_rate);
+void switch_baud_rate(uint32_t baud_rate);
+uint8_t serial_available(void);
+uint8_t serial_peek(void);
+uint8_t serial_tx_free(void);
+#ifdef BUS_LOOP_ASM
+uint8_t serial_burst_limit(void);
+#endif
+uint8_t receive_byte(void);
+void send_byte(uint8_t data);
+void send_byte_hex(uint8_t data);
+void send_string_P(const char *str);
+void send_decimal(uint32_t value);
+
+#endif // SERIAL_H
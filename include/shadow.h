@@ -0,0 +1,130 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Shadow registers: a best-effort copy of the 6502 registers kept by
+ * watching the bus, so 'G' can answer without opcode injection. Each
+ * cycle only looks up the class of the fetched opcode and latches the
+ * data and stack address of the access. The instruction's effect on the
+ * shadow is applied once, when the next opcode is fetched:
+ *
+ *   loads, stores, pushes and pulls   value seen on the data bus
+ *   transfers, INX/DEX/INY/DEY        computed from the shadow
+ *   stack traffic                     SP from the last stack address
+ *   flag instructions, PHP/PLP, BRK   P; other ALU ops leave it unknown
+ *
+ * Registers that cannot be followed (ALU results, RTI flags) are marked
+ * unknown until they are seen again. An interrupt is recognized by the
+ * cycle after the opcode fetch reading the same address again.
+ */
+
+#ifndef SHADOW_H
+#define SHADOW_H
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#include "registers.h"
+
+// Validity mask bits
+#define SHADOW_A        0x01
+#define SHADOW_X        0x02
+#define SHADOW_Y        0x04
+#define SHADOW_SP       0x08
+#define SHADOW_P        0x10
+#define SHADOW_ALL      0x1F
+
+// Opcode classes, by what the instruction does to the registers
+#define SH_NONE         0x00 // Nothing that is followed
+#define SH_FLAGS        0x01 // P unknown (compare, BIT, memory read-modify-write)
+#define SH_ALU_A        0x02 // A and P unknown
+#define SH_LOAD_A       0x03
+#define SH_LOAD_X       0x04
+#define SH_LOAD_Y       0x05
+#define SH_STORE_A      0x06
+#define SH_STORE_X      0x07
+#define SH_STORE_Y      0x08
+#define SH_PUSH_A       0x09
+#define SH_PUSH_X       0x0A
+#define SH_PUSH_Y       0x0B
+#define SH_PUSH_P       0x0C
+#define SH_PULL_A       0x0D
+#define SH_PULL_X       0x0E
+#define SH_PULL_Y       0x0F
+#define SH_PULL_P       0x10
+#define SH_STACK        0x11 // JSR, RTS
+#define SH_RTI          0x12
+#define SH_INTERRUPT    0x13 // BRK, IRQ, NMI
+#define SH_TAX          0x14
+#define SH_TAY          0x15
+#define SH_TXA          0x16
+#define SH_TYA          0x17
+#define SH_TSX          0x18
+#define SH_TXS          0x19
+#define SH_INX          0x1A
+#define SH_DEX          0x1B
+#define SH_INY          0x1C
+#define SH_DEY          0x1D
+#define SH_FLAG         0x1E // CLC, SEC, CLI, SEI, CLV, CLD, SED
+
+// Shadow state, updated by the bus service while enabled
+extern volatile uint8_t shadow_enabled;
+extern registers_t shadow;                  // PC is taken from the bus
+extern uint8_t shadow_valid;                // SHADOW_* bits
+extern uint8_t shadow_opcode;               // Instruction in progress
+extern uint8_t shadow_class;
+extern uint8_t shadow_cycle;                // Cycles since its fetch
+extern uint16_t shadow_fetch;               // Address of its fetch
+extern uint8_t shadow_read;                 // Data of its last read
+extern uint8_t shadow_write;                // Data of its last write
+extern uint8_t shadow_stack;                // SP implied by its last stack access
+extern const uint8_t shadow_classes[256] PROGMEM;
+
+// Function prototypes
+void start_shadow(void);
+void stop_shadow(void);
+void clear_shadow(void);
+void commit_shadow(void);
+void set_shadow(const registers_t *registers);
+uint8_t read_shadow(registers_t *registers);
+
+/**
+ * Start following a new instruction. Called by the bus service on every
+ * opcode fetch (SYNC high); the previous instruction is complete.
+ */
+static inline void record_shadow_fetch(uint16_t address, uint8_t opcode)
+{
+    commit_shadow();
+    shadow_opcode = opcode;
+    shadow_class = pgm_read_byte(&shadow_classes[opcode]);
+    shadow_cycle = 0;
+    shadow_fetch = address;
+}
+
+/**
+ * Latch a read (write = 0) or write (write = 1) cycle of the current
+ * instruction. Called by the bus service on every cycle but opcode fetches.
+ */
+static inline void record_shadow_access(uint16_t address, uint8_t data, uint8_t write)
+{
+    if (++shadow_cycle == 1 && address == shadow_fetch)
+    {
+        shadow_class = SH_INTERRUPT; // The fetched opcode is discarded
+    }
+
+    if (write)
+    {
+        shadow_write = data;
+    }
+    else
+    {
+        shadow_read = data;
+    }
+
+    if ((address >> 8) == 0x01)
+    {
+        // Pushes write at SP then decrement, pulls increment then read
+        shadow_stack = (uint8_t)address - write;
+    }
+}
+
+#endif // SHADOW_H
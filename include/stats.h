@@ -0,0 +1,44 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Bus performance counters. The C bus service counts every cycle it
+ * services. The assembly bus loop counts its writes, and the caller adds
+ * its reads and writes after every burst, but it never samples SYNC, so
+ * once bus.S has served a cycle since the last reset, the instruction
+ * count is reported as STAT_UNAVAILABLE rather than short.
+ *
+ * 'I' returns all counters as one block, in STAT_* order, each 4 bytes
+ * big-endian.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+// Counters, indices into stats[]
+enum
+{
+    STAT_CYCLES,       // PHI2 cycles, from the cycle counter
+    STAT_INSTRUCTIONS, // Opcode fetches (SYNC high)
+    STAT_READS,
+    STAT_WRITES,
+    STAT_IRQS,         // IRQ line assertions by the interrupt generator
+    STAT_NMIS,         // Same for NMI, right after STAT_IRQS
+    STAT_HITS,         // Breakpoint and watchpoint hits
+    STAT_UNMAPPED,     // 6502 accesses to unmapped pages
+    STATS_COUNTERS
+};
+
+// Value of the instruction counter once it missed cycles served by bus.S
+#define STAT_UNAVAILABLE 0xFFFFFFFFUL
+
+// Live counters; STAT_CYCLES is filled in by read_stats()
+extern uint32_t stats[STATS_COUNTERS];
+extern uint8_t stats_incomplete; // Set when bus.S served cycles since the last reset
+
+// Function prototypes
+void reset_stats(void);
+void read_stats(uint32_t *copy);
+
+#endif // STATS_H
@@ -0,0 +1,67 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Instruction trace: a ring buffer of the last TRACE_SIZE opcode fetches
+ * (SYNC high), each with its PC, opcode and the low 16 bits of the cycle
+ * counter. Recording is a few stores into fixed arrays, so it costs the
+ * same on every fetch.
+ *
+ * The buffer is downloaded with 'T' as one block, oldest entry first:
+ *
+ *   count | cycle counter (4) | PC[count] (2 each) | opcode[count] |
+ *   timestamp[count] (2 each)
+ *
+ * with all multi-byte values big-endian. The cycle counter is the value
+ * when recording stopped, so the host can extend the 16-bit timestamps.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#include "cpu.h"
+
+// Trace definitions, TRACE_SIZE must be a power of two no larger than 128
+// (5 bytes of SRAM per entry)
+#define TRACE_SIZE      32
+#define TRACE_HEADER    5  // Count and cycle counter
+
+// 'T' modes
+#define TRACE_STOP      0
+#define TRACE_START     1  // Clears the buffer
+#define TRACE_READ      2  // Stops recording and downloads the buffer
+
+// Trace buffer, one array per field so an entry is stored with plain indexing
+extern volatile uint8_t trace_enabled;
+extern uint16_t trace_pc[TRACE_SIZE];
+extern uint8_t trace_opcode[TRACE_SIZE];
+extern uint16_t trace_time[TRACE_SIZE];
+extern uint8_t trace_head;
+extern uint8_t trace_count;
+
+// Function prototypes
+void start_trace(void);
+void stop_trace(void);
+uint16_t trace_length(void);
+uint8_t trace_byte(uint16_t offset);
+
+/**
+ * Record an opcode fetch. Called by the bus service when SYNC is high.
+ */
+static inline void record_trace(uint16_t address, uint8_t opcode)
+{
+    uint8_t i = trace_head;
+
+    trace_pc[i] = address;
+    trace_opcode[i] = opcode;
+    trace_time[i] = (uint16_t)cycle_count;
+    trace_head = (i + 1) & (TRACE_SIZE - 1);
+
+    if (trace_count < TRACE_SIZE)
+    {
+        trace_count++;
+    }
+}
+
+#endif // TRACE_H
@@ -0,0 +1,32 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Decoder for compressed loads ('Z'). The stream is a sequence of
+ * tokens, each starting with a control byte:
+ *
+ *   0x00-0x7F  literal: the next (c + 1) bytes are copied as is
+ *   0x80-0xBF  fill:    the next byte is repeated (c & 0x3F) + 3 times
+ *   0xC0-0xFF  copy:    (c & 0x3F) + 3 bytes are copied from a distance
+ *                       given by the next 2 bytes (big-endian, 1-65535)
+ *
+ * Copies read back from 6502 memory that was already written, so the
+ * decoder needs no window buffer, only a few bytes of state. A distance
+ * of 1 repeats the previous byte.
+ */
+
+#ifndef UNPACK_H
+#define UNPACK_H
+
+#include <stdint.h>
+
+// Control byte ranges
+#define UNPACK_FILL     0x80 // Start of the fill tokens
+#define UNPACK_COPY     0xC0 // Start of the copy tokens
+#define UNPACK_MIN_RUN  3    // Shortest fill or copy
+
+// Function prototypes
+void unpack_begin(uint16_t address);
+uint8_t unpack_byte(uint8_t data);
+uint8_t unpack_idle(void);
+
+#endif // UNPACK_H
@@ -0,0 +1,235 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * IRQ/NMI generator and its status register.
+ */
+
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "irq.h"
+#include "stats.h"
+
+// Global variables
+volatile uint8_t generator_active = 0;
+uint32_t generator_period[2];
+uint32_t generator_deadline[2];
+uint16_t generator_address[2];
+
+// CONTROL_PORT bit of each line
+static const uint8_t line_bits[2] = {1 << CPU_IRQ, 1 << CPU_NMI};
+
+static uint8_t irq_read(uint16_t address);
+static void irq_write(uint16_t address, uint8_t data);
+
+const device_t irq_device = {{irq_read, irq_write}, IRQ_STATUS, IRQ_STATUS};
+
+/**
+ * Pull a line low. IRQ stays low until acknowledged, NMI until its
+ * vector is fetched. Only a line that was high counts as an assertion.
+ */
+void fire_line(uint8_t line)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (CONTROL_PORT & line_bits[line])
+        {
+            stats[STAT_IRQS + line]++;
+        }
+
+        CONTROL_PORT &= ~line_bits[line];
+    }
+}
+
+/**
+ * Configure the generator of a line (see irq.h for the modes).
+ * Returns 1 if successful, 0 if the settings are invalid.
+ */
+uint8_t set_generator(uint8_t line, uint8_t mode, uint32_t argument)
+{
+    if (line > LINE_NMI || mode > GEN_ADDRESS ||
+        (mode == GEN_PERIODIC && argument == 0) ||
+        (mode == GEN_ADDRESS && argument > 0xFFFF))
+    {
+        return 0;
+    }
+
+    uint8_t periodic = GEN_PERIODIC_IRQ << line;
+    uint8_t watch = GEN_ADDRESS_IRQ << line;
+    uint8_t old_page = generator_address[line] >> 8;
+    uint8_t had_watch = generator_active & watch;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        generator_active &= ~(periodic | watch);
+
+        switch (mode)
+        {
+        case GEN_OFF:
+            CONTROL_PORT |= line_bits[line];
+            break;
+        case GEN_ONCE:
+            fire_line(line);
+            break;
+        case GEN_PERIODIC:
+            generator_period[line] = argument;
+            generator_deadline[line] = cycle_count + argument;
+            generator_active |= periodic;
+            break;
+        case GEN_ADDRESS:
+            generator_address[line] = argument;
+            generator_active |= watch;
+            break;
+        }
+    }
+
+    // Pages with a watched address go through the C bus service
+    if (had_watch)
+    {
+        update_bus_page(old_page);
+    }
+
+    if (mode == GEN_ADDRESS)
+    {
+        update_bus_page(argument >> 8);
+    }
+
+    // So does the vector page while NMI is armed or held low
+    if (line == LINE_NMI)
+    {
+        update_bus_page(NMI_VECTOR >> 8);
+    }
+
+    return 1;
+}
+
+/**
+ * Fire the periodic generators whose deadline has come. Called after
+ * every cycle clocked by the C bus service and after every burst of the
+ * assembly bus loop, while a periodic generator is active.
+ */
+void check_generator(void)
+{
+    for (uint8_t line = LINE_IRQ; line <= LINE_NMI; line++)
+    {
+        if ((generator_active & (GEN_PERIODIC_IRQ << line)) &&
+            (int32_t)(cycle_count - generator_deadline[line]) >= 0)
+        {
+            fire_line(line);
+            generator_deadline[line] += generator_period[line];
+        }
+    }
+}
+
+/**
+ * Shorten a burst of the assembly bus loop (0 means 256 cycles) so that
+ * it ends on the next periodic deadline.
+ * Returns the burst length, 0 still meaning 256.
+ */
+uint8_t generator_burst(uint8_t cycles)
+{
+    uint16_t burst = cycles ? cycles : 256;
+
+    for (uint8_t line = LINE_IRQ; line <= LINE_NMI; line++)
+    {
+        if (generator_active & (GEN_PERIODIC_IRQ << line))
+        {
+            int32_t left = generator_deadline[line] - cycle_count;
+
+            if (left < 1)
+            {
+                left = 1;
+            }
+
+            if (left < burst)
+            {
+                burst = left;
+            }
+        }
+    }
+
+    return (uint8_t)burst;
+}
+
+/**
+ * Hold the generators off while the AVR clocks the 6502 by hand (register
+ * injection): nothing fires and IRQ is released, so the stub runs instead
+ * of the handler. A pending NMI cannot be held off, as the 6502 latches
+ * its edge and takes it at the next instruction boundary whatever the
+ * line does afterwards.
+ * Returns 1 with the state for resume_generator(), 0 if NMI is asserted.
+ */
+uint8_t suspend_generator(uint8_t *state)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (!(CONTROL_PORT & line_bits[LINE_NMI]))
+        {
+            return 0;
+        }
+
+        *state = generator_active;
+
+        if (!(CONTROL_PORT & line_bits[LINE_IRQ]))
+        {
+            *state |= GEN_IRQ_HELD;
+        }
+
+        generator_active = 0;
+        CONTROL_PORT |= line_bits[LINE_IRQ];
+    }
+
+    return 1;
+}
+
+/**
+ * Restart the generators and pull IRQ low again if it was asserted when
+ * they were suspended. That is the same assertion, so it is not counted.
+ */
+void resume_generator(uint8_t state)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        generator_active = state & ~GEN_IRQ_HELD;
+
+        if (state & GEN_IRQ_HELD)
+        {
+            CONTROL_PORT &= ~line_bits[LINE_IRQ];
+        }
+    }
+}
+
+/**
+ * Release both lines, as the 6502 has lost track of them on a reset.
+ * The generators keep running.
+ */
+void reset_generator(void)
+{
+    CONTROL_PORT |= line_bits[LINE_IRQ] | line_bits[LINE_NMI];
+    update_bus_page(NMI_VECTOR >> 8);
+}
+
+/**
+ * Read the status register. Other addresses in the page read as 0xFF.
+ */
+static uint8_t irq_read(uint16_t address)
+{
+    if (address != IRQ_STATUS)
+    {
+        return 0xFF;
+    }
+
+    return ((CONTROL_PORT & line_bits[LINE_IRQ]) ? 0 : IRQ_ASSERTED) |
+           ((CONTROL_PORT & line_bits[LINE_NMI]) ? 0 : NMI_ASSERTED);
+}
+
+/**
+ * Write the status register: bit 0 acknowledges the IRQ.
+ */
+static void irq_write(uint16_t address, uint8_t data)
+{
+    if (address == IRQ_STATUS && (data & IRQ_ASSERTED))
+    {
+        CONTROL_PORT |= line_bits[LINE_IRQ];
+    }
+}
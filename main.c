@@ -11,66 +11,108 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include <util/delay.h>
+#include <util/atomic.h>
 #include <string.h>
 
-// Define CPU control pins
-#define CPU_RESET       PD0
-#define CPU_RW          PD1
-#define CPU_IRQ         PD2
-#define CPU_NMI         PD3
-#define CPU_SYNC        PD4
-#define CPU_CLOCK       PD5
-
-// Define data bus port (e.g., PORTA)
-#define DATA_BUS        PORTA
-#define DATA_DIR        DDRA
-#define DATA_PIN        PINA
-
-// Define address bus ports (e.g., PORTC and PORTL for 16 bits)
-#define ADDR_BUS_LOW    PINC // Lower 8 bits
-#define ADDR_BUS_HIGH   PINL // Higher 8 bits
-
-// Define control signals
-#define CONTROL_PORT    PORTD
-#define CONTROL_DIR     DDRD
-#define CONTROL_PIN     PIND
-
-// Configurable baud rate (default to 9600)
+#include "pins.h"
+#include "bus.h"
+#include "breakpoint.h"
+#include "capture.h"
+#include "cpu.h"
+#include "irq.h"
+#include "memory.h"
+#include "pia.h"
+#include "profile.h"
+#include "protocol.h"
+#include "registers.h"
+#include "run.h"
+#include "serial.h"
+#include "shadow.h"
+#include "stats.h"
+#include "trace.h"
+#include "unpack.h"
+
+// Baud rate after reset (default to 9600), raised at runtime with 'N'
 #define BAUD_RATE       9600
 
-// Memory and breakpoint definitions
-#define MEMORY_SIZE     4096 // 4KB of memory
-#define MAX_BREAKPOINTS 10   // Maximum number of breakpoints
+// Run-mode clock engine (Timer1 in CTC mode, one PHI2 cycle per compare match)
+#ifdef BUS_LOOP_ASM
+#define CLOCK_DEFAULT_HZ 0UL     // Free-run the assembly bus loop
+// Paced bursts above CLOCK_MAX_HZ, up to the rate of the slowest bus.S
+// path (ROM reads), so the rate set holds whatever the code runs from
+#define CLOCK_TOP_HZ     (F_CPU / BUS_ASM_ROM_CYCLES)
+#else
+#define CLOCK_DEFAULT_HZ 10000UL // PHI2 frequency after power-up
+#define CLOCK_TOP_HZ     CLOCK_MAX_HZ
+#endif
+#define CLOCK_MIN_HZ     1UL     // Slowest rate reachable with the /1024 prescaler
+#define CLOCK_MAX_HZ     50000UL // Fastest rate the ISR bus service sustains
+#define CLOCK_APPLE1_HZ  1022727UL // Apple-1 preset (14.31818 MHz / 14), clamped to CLOCK_TOP_HZ
+
+// Paced bursts (assembly bus loop only): Timer1 free-runs at F_CPU / 8 as
+// the time base, and each burst moves the deadline on by the exact time
+// its cycles should take, so rounding never accumulates into drift
+#define PACE_PRESCALER   8
+#define PACE_BURST       32      // PHI2 cycles per burst
+#define PACE_MAX_LAG     20000   // Timer ticks (10 ms) of lag caught up before giving up
+// Timer ticks of the longest burst, the furthest the deadline gets ahead
+#define PACE_MAX_AHEAD   ((int16_t)(PACE_BURST * (F_CPU / PACE_PRESCALER / CLOCK_MAX_HZ)))
+#define STEP_MAX_CYCLES  16      // Longest 65C02 instruction, with margin
 
 // Function prototypes
 void init_cpu_interface(void);
-void init_serial(uint32_t baud_rate);
+void init_clock(void);
+#ifdef BUS_LOOP_ASM
+uint16_t clock_burst(uint8_t cycles);
+void clock_paced(void);
+#endif
+void bus_finish_cycle(void);
 void simulate_memory(void);
+void report_hit(uint8_t kind, uint16_t address, uint8_t data);
+void send_pending_hit(void);
+void send_display(void);
+void send_capture_done(void);
+void send_run_result(void);
+uint8_t command_length(uint8_t command);
 void handle_serial_command(void);
-uint8_t write_memory(uint16_t address, uint8_t data);
-uint8_t read_memory(uint16_t address, uint8_t *data);
-void reset_cpu(void);
-void halt_cpu(void);
-void release_cpu(void);
-void step_cpu(void);
-uint8_t receive_byte(void);
-void send_byte(uint8_t data);
-void send_byte_hex(uint8_t data);
-void send_string(const char *str);
-uint8_t calculate_checksum(uint8_t *data, uint16_t length);
+void continue_load(void);
 
 // Global variables
 volatile uint8_t cpu_running = 1;
-uint8_t memory[MEMORY_SIZE];           // Memory array to simulate 4KB of memory
-uint16_t breakpoints[MAX_BREAKPOINTS]; // Array to store breakpoints
-uint8_t breakpoint_count = 0;          // Number of breakpoints set
+uint32_t clock_frequency = 0;          // Current run-mode PHI2 frequency (Hz)
+static uint16_t clock_ticks;           // Timer1 ticks per PHI2 cycle, rounded down
+static uint32_t clock_remainder;       // Leftover ticks per second, spread by the ISR
+static uint32_t clock_error;           // Accumulated leftover, in 1/clock_frequency ticks
+#ifdef BUS_LOOP_ASM
+static uint32_t pace_step;             // Timer1 ticks per PHI2 cycle, 16.16 fixed point
+static uint16_t pace_tick;             // Deadline of the next burst
+static uint16_t pace_fraction;         // Fractional part of the deadline
+#endif
+volatile uint32_t cycle_count = 0;     // PHI2 cycles clocked since power-on
+volatile uint8_t breakpoint_hit = 0;   // HIT_* kind set by the bus service, reported by main()
+volatile uint16_t breakpoint_address;  // Address that triggered the breakpoint
+volatile uint8_t breakpoint_data;      // Data transferred by a watchpoint hit
+uint16_t load_address;                 // Next address of an 'L' in progress
+uint16_t load_remaining = 0;           // Payload bytes still expected by 'L'
+uint8_t load_error = 0;                // Set if the 'L' in progress hit an invalid address
+uint8_t load_packed;                   // Set if the load in progress is compressed ('Z')
 
 int main(void)
 {
     // Initialize CPU interface and serial communication
     init_cpu_interface();
+    uint8_t map_complete = init_memory_map();
     init_serial(BAUD_RATE);
+    init_clock();
+
+    // Never run the 6502 with a device missing from its address space
+    if (!map_complete)
+    {
+        halt_cpu();
+        send_string_P(PSTR("Error: Device registration failed.\n"));
+    }
 
     // Enable global interrupts
     sei();
@@ -78,17 +120,75 @@ int main(void)
     // Main loop
     while (1)
     {
-        // Check for serial commands from the PC
-        if (UCSR0A & (1 << RXC0))
+        // Check for serial commands from the PC (never blocks)
+        if (protocol_mode == PROTOCOL_FRAMED)
+        {
+            handle_frame_input();
+        }
+        else
         {
             handle_serial_command();
         }
 
-        // If CPU is running, simulate memory access
-        if (cpu_running)
+        // Stream the next chunk of a block dump once there is room for it
+        if (dump_active)
+        {
+            continue_dump();
+        }
+
+        // Report breakpoints hit by the bus service outside of the ISR,
+        // but never into a raw block dump
+        if (breakpoint_hit && (protocol_mode == PROTOCOL_FRAMED || !dump_active))
+        {
+            send_pending_hit();
+        }
+
+        // Report a completed capture once, after any raw block dump
+        if (capture_state == CAPTURE_DONE && (protocol_mode == PROTOCOL_FRAMED || !dump_active))
+        {
+            send_capture_done();
+        }
+
+        // Clock a batched step command, then report where it stopped
+        if (run_state == RUN_ACTIVE)
         {
-            simulate_memory();
+            continue_run();
+        }
+
+        if (run_state == RUN_DONE && (protocol_mode == PROTOCOL_FRAMED || !dump_active))
+        {
+            send_run_result();
+        }
+
+        // Forward PIA display output, but never into a raw block dump
+        if (display_available() && (protocol_mode == PROTOCOL_FRAMED || !dump_active))
+        {
+            send_display();
+        }
+
+#ifdef BUS_LOOP_ASM
+        // Free-running and paced modes: the assembly loop generates PHI2 itself
+        if (clock_frequency == 0)
+        {
+            if (cpu_running)
+            {
+                clock_burst(0); // 255 cycles, then poll the host again
+            }
+        }
+        else if (clock_frequency > CLOCK_MAX_HZ)
+        {
+            if (cpu_running)
+            {
+                clock_paced();
+            }
+            else
+            {
+                pace_tick = TCNT1; // Time spent halted is not caught up
+            }
         }
+#endif
+
+        // Otherwise PHI2 is generated by the Timer1 ISR
     }
 
     return 0;
@@ -115,383 +215,1214 @@ void init_cpu_interface(void)
 }
 
 /**
- * Initialize serial communication (UART) with configurable baud rate.
+ * Initialize the run-mode clock engine.
+ * Timer1 runs in CTC mode; every compare match clocks one PHI2 cycle.
  */
-void init_serial(uint32_t baud_rate)
+void init_clock(void)
 {
-    // Calculate UBRR value based on baud rate and CPU frequency
-    uint16_t ubrr_value = (F_CPU / (16UL * baud_rate)) - 1;
-
-    // Set baud rate
-    UBRR0H = (uint8_t)(ubrr_value >> 8);
-    UBRR0L = (uint8_t)(ubrr_value & 0xFF);
-
-    // Enable receiver and transmitter
-    UCSR0B = (1 << RXEN0) | (1 << TXEN0);
-
-    // Set frame format: 8 data bits, no parity, 1 stop bit
-    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
+    TCCR1A = 0x00;
+    set_clock_frequency(CLOCK_DEFAULT_HZ);
 }
 
 /**
- * Simulate memory for the 6502 CPU.
- * This function should be called continuously in the main loop.
+ * Set the run-mode PHI2 frequency in Hz, from CLOCK_MIN_HZ to
+ * CLOCK_TOP_HZ. CLOCK_APPLE1_HZ selects the Apple-1 preset, which runs
+ * at CLOCK_TOP_HZ when this build cannot reach it; clock_frequency holds
+ * the rate actually set.
+ * Up to CLOCK_MAX_HZ, Timer1 clocks every cycle from its ISR, using the
+ * smallest prescaler whose compare value fits in 16 bits. The fraction
+ * of a tick left over is spread across the cycles, so the average rate
+ * is exact. In assembly bus loop builds, faster rates run the loop in
+ * paced bursts, and 0 selects the free-running loop.
+ * Returns 1 if successful, 0 if the frequency is out of range.
  */
-void simulate_memory(void)
+uint8_t set_clock_frequency(uint32_t frequency)
 {
-    uint16_t address;
-    uint8_t data;
+    static const uint16_t prescalers[] = {1, 8, 64, 256, 1024};
 
-    // Read address bus
-    address = ((uint16_t)ADDR_BUS_HIGH << 8) | ADDR_BUS_LOW;
+    if (frequency == CLOCK_APPLE1_HZ && frequency > CLOCK_TOP_HZ)
+    {
+        frequency = CLOCK_TOP_HZ;
+    }
 
-    // Check if a breakpoint is reached
-    for (uint8_t i = 0; i < breakpoint_count; i++)
+#ifdef BUS_LOOP_ASM
+    if (frequency == 0 || (frequency > CLOCK_MAX_HZ && frequency <= CLOCK_TOP_HZ))
     {
-        if (address == breakpoints[i])
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
         {
-            halt_cpu();
-            send_string("Breakpoint reached at address: 0x");
-            send_byte_hex(address >> 8);
-            send_byte_hex(address & 0xFF);
-            send_string("\n");
-            break;
+            TCCR1B = 0x00; // bus_run() clocks PHI2 itself
+            TIMSK1 = 0x00;
+
+            if (frequency)
+            {
+                // Free-running time base for the bursts
+                pace_step = ((uint64_t)(F_CPU / PACE_PRESCALER) << 16) / frequency;
+                pace_fraction = 0;
+                TCNT1 = 0;
+                pace_tick = 0;
+                TCCR1B = (1 << CS11); // Normal mode, /8
+            }
         }
+
+        clock_frequency = frequency;
+        return 1;
     }
+#endif
 
-    // Check if CPU is performing a read or write operation
-    if (CONTROL_PIN & (1 << CPU_RW))
+    if (frequency < CLOCK_MIN_HZ || frequency > CLOCK_MAX_HZ)
     {
-        // CPU is reading from memory
-        if (read_memory(address, &data))
-        {
-            // Set data bus as output and put data on bus
-            DATA_DIR = 0xFF;
-            DATA_BUS = data;
+        return 0;
+    }
 
-            // Small delay to ensure data is stable
-            _delay_us(1);
+    for (uint8_t i = 0; i < sizeof(prescalers) / sizeof(prescalers[0]); i++)
+    {
+        uint32_t rate = F_CPU / prescalers[i];
+        uint32_t ticks = rate / frequency;
 
-            // Set data bus back to input to avoid bus contention
-            DATA_DIR = 0x00;
-        }
-        else
+        if (ticks < 65536UL)
         {
-            // Address out of range; provide default data
-            DATA_DIR = 0xFF;
-            DATA_BUS = 0xFF;
-            _delay_us(1);
-            DATA_DIR = 0x00;
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+            {
+                TCCR1B = 0x00; // Stop the timer while reprogramming it
+                TCNT1 = 0;
+                OCR1A = (uint16_t)(ticks - 1);
+                clock_ticks = ticks;
+                clock_remainder = rate % frequency;
+                clock_error = 0;
+                clock_frequency = frequency;
+                TIMSK1 = (1 << OCIE1A);
+                TCCR1B = (1 << WGM12) | (i + 1); // CTC mode, CS1[2:0] = i + 1
+            }
+
+            return 1;
         }
     }
-    else
-    {
-        // CPU is writing to memory
-        // Set data bus as input
-        DATA_DIR = 0x00;
-
-        // Read data from data bus
-        data = DATA_PIN;
 
-        // Store data in memory
-        write_memory(address, data);
-    }
+    return 0;
 }
 
 /**
- * Handle serial commands received from the PC.
- * Commands can be used to read/write memory, control CPU, etc.
+ * Timer1 compare match: clock one PHI2 cycle while the CPU is running.
+ * The next period is one tick longer whenever the leftover fractions add
+ * up to a whole tick.
  */
-void handle_serial_command(void)
+ISR(TIMER1_COMPA_vect)
 {
-    uint8_t command = receive_byte(); // Read the command
+    clock_error += clock_remainder;
 
-    switch (command)
+    if (clock_error >= clock_frequency)
     {
-    case 'R': // Reset CPU
-        reset_cpu();
-        send_string("CPU reset.\n");
-        break;
-
-    case 'H': // Halt CPU
-        halt_cpu();
-        send_string("CPU halted.\n");
-        break;
-
-    case 'C': // Continue CPU
-        release_cpu();
-        send_string("CPU continued.\n");
-        break;
-
-    case 'S': // Step CPU
-        step_cpu();
-        send_string("CPU stepped one instruction.\n");
-        break;
+        clock_error -= clock_frequency;
+        OCR1A = clock_ticks;
+    }
+    else
+    {
+        OCR1A = clock_ticks - 1;
+    }
 
-    case 'W': // Write memory
+    if (cpu_running)
     {
-        // Read address (2 bytes)
-        uint16_t address = ((uint16_t)receive_byte() << 8) | receive_byte();
+        bus_cycle();
+    }
+}
 
-        // Read data
-        uint8_t data = receive_byte();
+/**
+ * Check whether the run-mode clock has to leave the assembly bus loop
+ * for the much slower C bus service, cycle by cycle: at rates above
+ * CLOCK_MAX_HZ while the trace, capture, shadow registers or profiler
+ * need to see every cycle. Always 0 without the assembly bus loop.
+ */
+uint8_t bus_loop_bypassed(void)
+{
+#ifdef BUS_LOOP_ASM
+    return (clock_frequency == 0 || clock_frequency > CLOCK_MAX_HZ) &&
+           (trace_enabled || capture_recording() || shadow_enabled || profile_mode);
+#else
+    return 0;
+#endif
+}
 
-        if (write_memory(address, data))
-        {
-            send_string("Memory written at address 0x");
-            send_byte_hex(address >> 8);
-            send_byte_hex(address & 0xFF);
-            send_string(".\n");
-        }
-        else
-        {
-            send_string("Error: Invalid address.\n");
-        }
+#ifdef BUS_LOOP_ASM
+/**
+ * Clock a burst of PHI2 cycles (0 means 256) with the assembly bus loop,
+ * or through the C bus service while the trace, capture, shadow registers
+ * or profiler need to see every cycle. Stops early if the CPU halts.
+ * Returns the number of cycles clocked.
+ */
+uint16_t clock_burst(uint8_t cycles)
+{
+    cycles = generator_burst(cycles); // End on the next periodic interrupt
 
-        break;
-    }
+    uint16_t wanted = cycles ? cycles : 256;
 
-    case 'M': // Read memory
+    if (bus_loop_bypassed())
     {
-        // Read address (2 bytes)
-        uint16_t address = ((uint16_t)receive_byte() << 8) | receive_byte();
-        uint8_t data;
+        uint16_t done = 0;
 
-        if (read_memory(address, &data))
-        {
-            send_byte(data); // Send data back to PC
-        }
-        else
+        // Each cycle takes a good deal longer here, so end the burst once
+        // the receive buffer is half full rather than by a fixed length
+        do
         {
-            send_string("Error: Invalid address.\n");
-        }
+            bus_cycle();
+        } while (++done < wanted && cpu_running && serial_available() < SERIAL_RX_SIZE / 2);
 
-        break;
+        return done;
     }
 
-    case 'L': // Load data into memory
+    // A 256-cycle burst handed over on its first cycle would return 0,
+    // which reads as done, so bus.S bursts stop at 255 cycles
+    if (!cycles)
     {
-        // Read address (2 bytes)
-        uint16_t address = ((uint16_t)receive_byte() << 8) | receive_byte();
+        cycles = 255;
+        wanted = 255;
+    }
 
-        // Read size (2 bytes)
-        uint16_t size = ((uint16_t)receive_byte() << 8) | receive_byte();
+    // Keep the receive buffer from overflowing at high baud rates
+    uint8_t limit = serial_burst_limit();
 
-        // Read data
-        uint8_t data;
-        uint16_t i;
+    if (cycles > limit)
+    {
+        cycles = limit;
+        wanted = limit;
+    }
 
-        for (i = 0; i < size; i++)
-        {
-            data = receive_byte();
-            if (!write_memory(address + i, data))
-            {
-                send_string("Error: Invalid address during load.\n");
-                break;
-            }
-        }
+    uint8_t writes;
+    uint8_t left = bus_run(cycles, &writes);
+    uint8_t served = wanted - left;
 
-        if (i == size)
-        {
-            send_string("Data loaded successfully.\n");
-        }
+    cycle_count += served;
+    stats[STAT_READS] += served - writes;
+    stats[STAT_WRITES] += writes;
 
-        break;
+    if (served)
+    {
+        stats_incomplete = 1; // bus.S does not look at SYNC
     }
 
-    case 'B': // Set breakpoint
+    if (generator_active & GEN_PERIODIC_ANY)
     {
-        if (breakpoint_count >= MAX_BREAKPOINTS)
-        {
-            send_string("Error: Maximum number of breakpoints reached.\n");
-            break;
-        }
-
-        // Read address (2 bytes)
-        uint16_t address = ((uint16_t)receive_byte() << 8) | receive_byte();
-        breakpoints[breakpoint_count++] = address;
-        send_string("Breakpoint set at address 0x");
-        send_byte_hex(address >> 8);
-        send_byte_hex(address & 0xFF);
-        send_string(".\n");
-        break;
+        check_generator();
     }
 
-    case 'G': // Get CPU registers (not implemented)
+    if (left)
     {
-        send_string("Error: Register reading not supported.\n");
-        break;
+        bus_finish_cycle(); // Page handed over by bus.S
+        return wanted - left + 1;
     }
 
-    default:
-        // Unknown command
-        send_string("Error: Unknown command.\n");
-        break;
-    }
+    return wanted;
 }
 
 /**
- * Write a byte to memory at the specified address.
- * Returns 1 if successful, 0 if the address is invalid.
+ * Run the next paced burst if its deadline has come, then move the
+ * deadline on by the time its cycles take at clock_frequency.
  */
-uint8_t write_memory(uint16_t address, uint8_t data)
+void clock_paced(void)
 {
-    if (address < MEMORY_SIZE)
-    {
-        memory[address] = data;
-        return 1;
-    }
-    else
-    {
-        return 0; // Address out of range
-    }
-}
+    int16_t lag = TCNT1 - pace_tick;
 
-/**
- * Read a byte from memory at the specified address.
- * Returns 1 if successful, 0 if the address is invalid.
- */
-uint8_t read_memory(uint16_t address, uint8_t *data)
-{
-    if (address < MEMORY_SIZE)
+    // The deadline is never further ahead than one burst; beyond that the
+    // lag has wrapped around
+    if (lag < 0 && lag >= -PACE_MAX_AHEAD)
     {
-        *data = memory[address];
-        return 1;
+        return; // Ahead of time
     }
-    else
+
+    if (lag < 0 || lag > PACE_MAX_LAG)
     {
-        *data = 0xFF; // Default value
-        return 0;     // Address out of range
+        pace_tick += lag; // Held up too long (host traffic), resume from now
     }
-}
 
-/**
- * Reset the 6502 CPU.
- */
-void reset_cpu(void)
-{
-    // Pull RESET low for a short time
-    CONTROL_PORT &= ~(1 << CPU_RESET);
-    _delay_ms(10);
-    CONTROL_PORT |= (1 << CPU_RESET);
-    cpu_running = 1;
+    uint32_t step = clock_burst(PACE_BURST) * pace_step + pace_fraction;
+
+    pace_tick += step >> 16;
+    pace_fraction = step & 0xFFFF;
 }
+#endif
 
 /**
- * Halt the 6502 CPU by stopping memory simulation.
+ * Clock one complete PHI2 cycle and service the bus exactly once.
+ * The address and R/W lines are stable while PHI2 is high; the 6502
+ * latches read data on the falling edge, after which the bus is released.
  */
-void halt_cpu(void)
+void bus_cycle(void)
 {
-    cpu_running = 0;
+    CONTROL_PORT |= (1 << CPU_CLOCK); // PHI2 high
+    bus_finish_cycle();
 }
 
 /**
- * Release the 6502 CPU to continue execution.
+ * Service the bus and end a PHI2 cycle that is already in its high phase.
  */
-void release_cpu(void)
+void bus_finish_cycle(void)
 {
-    cpu_running = 1;
+    simulate_memory();                 // Drive or latch the data bus
+    CONTROL_PORT &= ~(1 << CPU_CLOCK); // PHI2 low, read data is latched
+    DATA_DIR = 0x00;                   // Release the data bus
+    cycle_count++;
+
+    if (generator_active & GEN_PERIODIC_ANY)
+    {
+        check_generator();
+    }
 }
 
 /**
- * Step the 6502 CPU by simulating one instruction.
+ * Simulate memory for the 6502 CPU.
+ * Services the bus for the current PHI2 cycle; called by bus_cycle().
+ * On reads the data bus is left driven until bus_cycle() releases it.
  */
-void step_cpu(void)
+void simulate_memory(void)
 {
-    // Halt the CPU to ensure control
-    halt_cpu();
+    uint16_t address;
+    uint8_t data;
 
-    // Execute one instruction by monitoring SYNC signal
-    uint8_t sync_high = 0;
+    // Read address bus
+    address = ((uint16_t)ADDR_BUS_HIGH << 8) | ADDR_BUS_LOW;
 
-    do
+    if (generator_active & GEN_ADDRESS_ANY)
     {
-        // Generate a clock pulse
-        CONTROL_PORT |= (1 << CPU_CLOCK);  // Clock high
-        _delay_us(1);                      // Small delay
-        CONTROL_PORT &= ~(1 << CPU_CLOCK); // Clock low
-        _delay_us(1);                      // Small delay
+        check_generator_address(address);
+    }
 
-        // Simulate memory access during this cycle
-        simulate_memory();
+    // Check if CPU is performing a read or write operation
+    if (CONTROL_PIN & (1 << CPU_RW))
+    {
+        // CPU is reading from memory; unmapped pages read as 0xFF
+        // Put data on the bus; bus_cycle() releases it after PHI2 falls
+        data = bus_read(address);
+        DATA_BUS = data;
+        DATA_DIR = 0xFF;
+        stats[STAT_READS]++;
 
-        // Check SYNC signal
         if (CONTROL_PIN & (1 << CPU_SYNC))
         {
-            if (!sync_high)
+            stats[STAT_INSTRUCTIONS]++;
+
+            if (trace_enabled)
+            {
+                record_trace(address, data);
+            }
+
+            if (shadow_enabled)
+            {
+                record_shadow_fetch(address, data);
+            }
+
+            if (profile_mode)
+            {
+                record_profile(address);
+            }
+
+            if (capture_recording())
+            {
+                record_capture(address, data, CAPTURE_READ | CAPTURE_SYNC);
+            }
+
+            // Opcode fetch: only execution breakpoints apply
+            if (check_breakpoint(address))
             {
-                // SYNC just went high, beginning of a new instruction
-                sync_high = 1;
+                report_hit(HIT_BREAKPOINT, address, data);
             }
         }
         else
         {
-            if (sync_high)
+            if (capture_recording())
+            {
+                record_capture(address, data, CAPTURE_READ);
+            }
+
+            if (shadow_enabled)
+            {
+                record_shadow_access(address, data, 0);
+            }
+
+            if (address == NMI_VECTOR)
             {
-                // SYNC just went low, instruction complete
-                break;
+                release_nmi(); // One edge per NMI fired
             }
+
+            if (check_watchpoint(address, WATCH_READ, data))
+            {
+                report_hit(HIT_WATCH_READ, address, data);
+            }
+        }
+    }
+    else
+    {
+        // CPU is writing to memory
+        // Set data bus as input
+        DATA_DIR = 0x00;
+
+        // Store data from the data bus through the page table
+        data = DATA_PIN;
+        bus_write(address, data);
+        stats[STAT_WRITES]++;
+
+        if (capture_recording())
+        {
+            record_capture(address, data, CAPTURE_WRITE);
+        }
+
+        if (shadow_enabled)
+        {
+            record_shadow_access(address, data, 1);
+        }
+
+        if (check_watchpoint(address, WATCH_WRITE, data))
+        {
+            report_hit(HIT_WATCH_WRITE, address, data);
         }
-    } while (1);
+    }
 }
 
 /**
- * Receive a byte from the serial port.
+ * Halt the CPU and record a breakpoint or watchpoint hit for main().
  */
-uint8_t receive_byte(void)
+void report_hit(uint8_t kind, uint16_t address, uint8_t data)
 {
-    // Wait for data to be received
-    while (!(UCSR0A & (1 << RXC0)))
-        ;
-    // Return received data
-    return UDR0;
+    halt_cpu();
+    stats[STAT_HITS]++;
+    breakpoint_address = address;
+    breakpoint_data = data;
+    breakpoint_hit = kind;
 }
 
 /**
- * Send a byte via the serial port.
+ * Send the breakpoint or watchpoint hit recorded by report_hit().
+ * In framed mode it goes out as an event frame: kind, address, data.
  */
-void send_byte(uint8_t data)
+void send_pending_hit(void)
 {
-    // Wait for empty transmit buffer
-    while (!(UCSR0A & (1 << UDRE0)))
-        ;
-    // Put data into buffer, sends the data
-    UDR0 = data;
-}
-
+    uint8_t kind;
+    uint16_t address;
+    uint8_t data;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        kind = breakpoint_hit;
+        address = breakpoint_address;
+        data = breakpoint_data;
+        breakpoint_hit = 0;
+    }
+
+    if (protocol_mode == PROTOCOL_FRAMED)
+    {
+        uint8_t event[4] = {kind, address >> 8, address & 0xFF, data};
+        send_frame(0, STATUS_EVENT, event, sizeof(event));
+    }
+    else if (kind == HIT_BREAKPOINT)
+    {
+        send_string_P(PSTR("Breakpoint reached at address: 0x"));
+        send_byte_hex(address >> 8);
+        send_byte_hex(address & 0xFF);
+        send_string_P(PSTR("\n"));
+    }
+    else
+    {
+        send_string_P(PSTR("Watchpoint hit at address: 0x"));
+        send_byte_hex(address >> 8);
+        send_byte_hex(address & 0xFF);
+        send_string_P(kind == HIT_WATCH_READ ? PSTR(", read 0x") : PSTR(", write 0x"));
+        send_byte_hex(data);
+        send_string_P(PSTR("\n"));
+    }
+}
+
+/**
+ * Send the result of a batched step command ('s'). In framed mode it is
+ * the deferred response to the request: reason, PC, instruction count.
+ */
+void send_run_result(void)
+{
+    uint8_t result[RUN_RESULT];
+
+    run_result(result);
+
+    if (protocol_mode == PROTOCOL_FRAMED)
+    {
+        send_frame(run_seq, STATUS_OK, result, sizeof(result));
+    }
+    else
+    {
+        send_string_P(PSTR("Stopped at "));
+        send_byte_hex(run_pc >> 8);
+        send_byte_hex(run_pc & 0xFF);
+        send_string_P(PSTR(" after "));
+        send_decimal(run_count);
+        send_string_P(PSTR(" instructions.\n"));
+    }
+}
+
+/**
+ * Tell the host that the capture has completed and can be read with 'Y'.
+ * In framed mode it goes out as an event frame: kind, sample count.
+ */
+void send_capture_done(void)
+{
+    capture_state = CAPTURE_READY;
+
+    if (protocol_mode == PROTOCOL_FRAMED)
+    {
+        uint8_t event[3] = {EVENT_CAPTURE, capture_count >> 8, capture_count & 0xFF};
+        send_frame(0, STATUS_EVENT, event, sizeof(event));
+    }
+    else
+    {
+        send_string_P(PSTR("Capture complete, "));
+        send_decimal(capture_count);
+        send_string_P(PSTR(" samples.\n"));
+    }
+}
+
+/**
+ * Forward the characters the 6502 wrote to the PIA display, as far as
+ * the transmit buffer has room. Legacy mode sends them as text with CR
+ * turned into a newline, framed mode as a display event.
+ */
+void send_display(void)
+{
+    uint8_t count = display_available();
+    uint8_t room = serial_tx_free();
+
+    if (protocol_mode == PROTOCOL_FRAMED)
+    {
+        uint8_t event[1 + DISPLAY_SIZE] = {EVENT_DISPLAY};
+
+        if (room <= FRAME_OVERHEAD + 1)
+        {
+            return;
+        }
+
+        if (count > room - FRAME_OVERHEAD - 1)
+        {
+            count = room - FRAME_OVERHEAD - 1;
+        }
+
+        for (uint8_t i = 1; i <= count; i++)
+        {
+            event[i] = display_read();
+        }
+
+        send_frame(0, STATUS_EVENT, event, count + 1);
+        return;
+    }
+
+    while (count-- && room--)
+    {
+        uint8_t data = display_read();
+        send_byte(data == '\r' ? '\n' : data);
+    }
+}
+
 /**
- * Send a byte in hexadecimal format via the serial port.
+ * Return the number of argument bytes that follow a command byte.
  */
-void send_byte_hex(uint8_t data)
+uint8_t command_length(uint8_t command)
 {
-    const char hex_digits[] = "0123456789ABCDEF";
-    send_byte(hex_digits[(data >> 4) & 0x0F]);
-    send_byte(hex_digits[data & 0x0F]);
+    switch (command)
+    {
+    case 'W':
+        return 3; // Address, data
+    case 'P':
+        return 1; // Protocol mode
+    case 'K':
+        return 1; // Key
+    case 'T':
+        return 1; // Trace mode
+    case 'V':
+        return 9; // Capture range, data value and mask, access, depths
+    case 'J':
+        return 7; // A, X, Y, SP, P and PC
+    case 'O':
+        return 1; // Shadow registers on or off
+    case 'I':
+        return 1; // Reset the counters after reading them
+    case 'p':
+        return 6; // Profiler mode, base address, bucket shift, period
+    case 's':
+        return 3; // Step mode, count or address
+    case 'i':
+        return 6; // Interrupt line, generator mode, period or address
+    case 'Q':
+        return 2; // First page, page count
+    case 'M':
+    case 'B':
+    case 'D':
+    case 'E':
+        return 2; // Address
+    case 'L':
+    case 'Z':
+    case 'A':
+    case 'F':
+    case 'N':
+    case 'X':
+        return 4; // Address and size/length, address and qualifiers, frequency, baud rate
+    default:
+        return 0;
+    }
 }
 
 /**
- * Send a string via the serial port.
+ * Handle serial commands received from the PC.
+ * Commands can be used to read/write memory, control CPU, etc.
+ * A command runs only once all of its argument bytes have arrived,
+ * so this returns immediately while the host link is slow.
  */
-void send_string(const char *str)
+void handle_serial_command(void)
 {
-    while (*str)
+    // Payload of an 'L' in progress
+    if (load_remaining)
+    {
+        continue_load();
+        return;
+    }
+
+    // Hold further commands until a raw block dump is out
+    if (dump_active)
+    {
+        return;
+    }
+
+    uint8_t available = serial_available();
+
+    if (!available || available < 1 + command_length(serial_peek()))
+    {
+        return;
+    }
+
+    uint8_t command = receive_byte(); // Read the command
+
+    switch (command)
+    {
+    case 'R': // Reset CPU
+        reset_cpu();
+        send_string_P(PSTR("CPU reset.\n"));
+        break;
+
+    case 'H': // Halt CPU
+        cancel_run();
+        halt_cpu();
+        send_string_P(PSTR("CPU halted.\n"));
+        break;
+
+    case 'C': // Continue CPU
+        release_cpu();
+        send_string_P(PSTR("CPU continued.\n"));
+        break;
+
+    case 'S': // Step CPU
+        step_cpu();
+        send_string_P(PSTR("CPU stepped one instruction.\n"));
+        break;
+
+    case 's': // Batched step, reported when it stops
+    {
+        // Read mode and argument (2 bytes)
+        uint8_t mode = receive_byte();
+        uint16_t argument = ((uint16_t)receive_byte() << 8) | receive_byte();
+
+        if (!start_run(mode, argument, 0))
+        {
+            send_string_P(PSTR("Error: Invalid step command.\n"));
+        }
+
+        break;
+    }
+
+    case 'i': // Set up the IRQ/NMI generator
+    {
+        // Read line, mode and argument (4 bytes)
+        uint8_t line = receive_byte();
+        uint8_t mode = receive_byte();
+        uint32_t argument = ((uint32_t)receive_byte() << 24);
+        argument |= ((uint32_t)receive_byte() << 16);
+        argument |= ((uint32_t)receive_byte() << 8);
+        argument |= receive_byte();
+
+        if (set_generator(line, mode, argument))
+        {
+            send_string_P(PSTR("Interrupt generator set.\n"));
+        }
+        else
+        {
+            send_string_P(PSTR("Error: Invalid interrupt settings.\n"));
+        }
+
+        break;
+    }
+
+    case 'W': // Write memory
+    {
+        // Read address (2 bytes)
+        uint16_t address = ((uint16_t)receive_byte() << 8) | receive_byte();
+
+        // Read data
+        uint8_t data = receive_byte();
+
+        if (write_memory(address, data))
+        {
+            send_string_P(PSTR("Memory written at address 0x"));
+            send_byte_hex(address >> 8);
+            send_byte_hex(address & 0xFF);
+            send_string_P(PSTR(".\n"));
+        }
+        else
+        {
+            send_string_P(PSTR("Error: Invalid address.\n"));
+        }
+
+        break;
+    }
+
+    case 'M': // Read memory
+    {
+        // Read address (2 bytes)
+        uint16_t address = ((uint16_t)receive_byte() << 8) | receive_byte();
+        uint8_t data;
+
+        if (read_memory(address, &data))
+        {
+            send_byte(data); // Send data back to PC
+        }
+        else
+        {
+            send_string_P(PSTR("Error: Invalid address.\n"));
+        }
+
+        break;
+    }
+
+    case 'K': // Key for the PIA keyboard
+        if (!pia_key(receive_byte()))
+        {
+            send_string_P(PSTR("Error: Keyboard buffer full.\n"));
+        }
+        break;
+
+    case 'T': // Control the instruction trace
+    {
+        uint8_t mode = receive_byte();
+
+        if (mode == TRACE_START)
+        {
+            start_trace();
+            send_string_P(PSTR("Trace started.\n"));
+        }
+        else if (mode == TRACE_STOP)
+        {
+            stop_trace();
+            send_string_P(PSTR("Trace stopped.\n"));
+        }
+        else if (mode == TRACE_READ)
+        {
+            // The buffer and its CRC are sent raw by continue_dump()
+            start_trace_dump(0);
+        }
+        else
+        {
+            send_string_P(PSTR("Error: Invalid trace mode.\n"));
+        }
+
+        break;
+    }
+
+    case 'p': // Control the PC profiler
+    {
+        // Read mode, base address (2 bytes), bucket shift and period (2 bytes)
+        uint8_t mode = receive_byte();
+        uint16_t base = ((uint16_t)receive_byte() << 8) | receive_byte();
+        uint8_t shift = receive_byte();
+        uint16_t period = ((uint16_t)receive_byte() << 8) | receive_byte();
+
+        if (mode == PROFILE_STOP)
+        {
+            stop_profile();
+            send_string_P(PSTR("Profiler stopped.\n"));
+        }
+        else if (mode == PROFILE_READ)
+        {
+            start_profile_dump(0);
+        }
+        else if (start_profile(mode, base, shift, period))
+        {
+            send_string_P(PSTR("Profiler started.\n"));
+        }
+        else
+        {
+            send_string_P(PSTR("Error: Invalid profiler settings.\n"));
+        }
+
+        break;
+    }
+
+    case 'V': // Arm the logic-analyzer capture
+    {
+        // Read address range (2 bytes each), data value, mask, access, depths
+        uint16_t low = ((uint16_t)receive_byte() << 8) | receive_byte();
+        uint16_t high = ((uint16_t)receive_byte() << 8) | receive_byte();
+        uint8_t value = receive_byte();
+        uint8_t mask = receive_byte();
+        uint8_t access = receive_byte();
+        uint8_t pre = receive_byte();
+        uint8_t post = receive_byte();
+
+        if (!access)
+        {
+            disarm_capture();
+            send_string_P(PSTR("Capture disarmed.\n"));
+        }
+        else if (arm_capture(low, high, value, mask, access, pre, post))
+        {
+            send_string_P(PSTR("Capture armed.\n"));
+        }
+        else
+        {
+            send_string_P(PSTR("Error: Invalid capture settings.\n"));
+        }
+
+        break;
+    }
+
+    case 'Y': // Read the capture
+        if (capture_state == CAPTURE_IDLE)
+        {
+            send_string_P(PSTR("Error: No capture.\n"));
+        }
+        else if (capture_recording())
+        {
+            send_string_P(PSTR("Error: Capture in progress.\n"));
+        }
+        else
+        {
+            // The samples and their CRC are sent raw by continue_dump()
+            start_capture_dump(0);
+        }
+        break;
+
+    case 'U': // Fetch and clear dirty pages
+        // The bitmap, the pages and their CRC are sent raw by continue_dump()
+        start_dirty_dump(0);
+        break;
+
+    case 'X': // Dump memory block
+    {
+        // Read address and length (2 bytes each)
+        uint16_t address = ((uint16_t)receive_byte() << 8) | receive_byte();
+        uint16_t length = ((uint16_t)receive_byte() << 8) | receive_byte();
+
+        // The data and its CRC are sent raw by continue_dump()
+        if (!start_dump(address, length, 0))
+        {
+            send_string_P(PSTR("Error: Invalid address.\n"));
+        }
+
+        break;
+    }
+
+    case 'Q': // Query page hashes
+    {
+        // Read first page and page count (0 means 256)
+        uint8_t first_page = receive_byte();
+        uint8_t pages = receive_byte();
+
+        if (first_page + (pages ? pages : 256) > 256 || !pages_readable(first_page, pages))
+        {
+            send_string_P(PSTR("Error: Invalid address.\n"));
+            break;
+        }
+
+        // The hashes and their CRC are sent raw by continue_dump()
+        start_hash_dump(first_page, pages, 0);
+        break;
+    }
+
+    case 'L': // Load data into memory
+    {
+        // Read address (2 bytes)
+        load_address = ((uint16_t)receive_byte() << 8) | receive_byte();
+
+        // Read size (2 bytes); the data follows and is consumed by continue_load()
+        load_remaining = ((uint16_t)receive_byte() << 8) | receive_byte();
+        load_error = 0;
+        load_packed = 0;
+
+        if (!load_remaining)
+        {
+            send_string_P(PSTR("Data loaded successfully.\n"));
+        }
+
+        break;
+    }
+
+    case 'Z': // Load compressed data into memory
+    {
+        // Read address (2 bytes)
+        unpack_begin(((uint16_t)receive_byte() << 8) | receive_byte());
+
+        // Read compressed size (2 bytes); the stream is decoded by continue_load()
+        load_remaining = ((uint16_t)receive_byte() << 8) | receive_byte();
+        load_error = 0;
+        load_packed = 1;
+
+        if (!load_remaining)
+        {
+            send_string_P(PSTR("Data loaded successfully.\n"));
+        }
+
+        break;
+    }
+
+    case 'B': // Set breakpoint
+    {
+        // Read address (2 bytes)
+        uint16_t address = ((uint16_t)receive_byte() << 8) | receive_byte();
+
+        if (!add_breakpoint(address))
+        {
+            send_string_P(PSTR("Error: Maximum number of breakpoints reached.\n"));
+            break;
+        }
+
+        send_string_P(PSTR("Breakpoint set at address 0x"));
+        send_byte_hex(address >> 8);
+        send_byte_hex(address & 0xFF);
+        send_string_P(PSTR(".\n"));
+        break;
+    }
+
+    case 'D': // Delete breakpoint
+    {
+        // Read address (2 bytes)
+        uint16_t address = ((uint16_t)receive_byte() << 8) | receive_byte();
+
+        if (!remove_breakpoint(address))
+        {
+            send_string_P(PSTR("Error: No breakpoint at address.\n"));
+            break;
+        }
+
+        send_string_P(PSTR("Breakpoint cleared at address 0x"));
+        send_byte_hex(address >> 8);
+        send_byte_hex(address & 0xFF);
+        send_string_P(PSTR(".\n"));
+        break;
+    }
+
+    case 'A': // Add watchpoint
+    {
+        // Read address (2 bytes), WATCH_* flags and match value
+        uint16_t address = ((uint16_t)receive_byte() << 8) | receive_byte();
+        uint8_t flags = receive_byte();
+        uint8_t value = receive_byte();
+
+        if (!add_watchpoint(address, flags, value))
+        {
+            send_string_P(PSTR("Error: Cannot set watchpoint.\n"));
+            break;
+        }
+
+        send_string_P(PSTR("Watchpoint set at address 0x"));
+        send_byte_hex(address >> 8);
+        send_byte_hex(address & 0xFF);
+        send_string_P(PSTR(".\n"));
+        break;
+    }
+
+    case 'E': // Erase watchpoint
+    {
+        // Read address (2 bytes)
+        uint16_t address = ((uint16_t)receive_byte() << 8) | receive_byte();
+
+        if (!remove_watchpoint(address))
+        {
+            send_string_P(PSTR("Error: No watchpoint at address.\n"));
+            break;
+        }
+
+        send_string_P(PSTR("Watchpoint cleared at address 0x"));
+        send_byte_hex(address >> 8);
+        send_byte_hex(address & 0xFF);
+        send_string_P(PSTR(".\n"));
+        break;
+    }
+
+    case 'F': // Set run-mode clock frequency
+    {
+        // Read frequency in Hz (4 bytes)
+        uint32_t frequency = ((uint32_t)receive_byte() << 24);
+        frequency |= ((uint32_t)receive_byte() << 16);
+        frequency |= ((uint32_t)receive_byte() << 8);
+        frequency |= receive_byte();
+
+        if (set_clock_frequency(frequency))
+        {
+            if (clock_frequency)
+            {
+                send_string_P(PSTR("Clock set to "));
+                send_decimal(clock_frequency);
+            }
+            else
+            {
+                send_string_P(PSTR("Clock free-running, up to "));
+                send_decimal(BUS_ASM_HZ);
+            }
+
+            if (bus_loop_bypassed())
+            {
+                send_string_P(PSTR(" Hz, but trace, capture, shadow or profiler slow it down.\n"));
+            }
+            else
+            {
+                send_string_P(PSTR(" Hz.\n"));
+            }
+        }
+        else
+        {
+            send_string_P(PSTR("Error: Invalid clock frequency.\n"));
+        }
+
+        break;
+    }
+
+    case 'N': // Negotiate baud rate
+    {
+        // Read baud rate (4 bytes)
+        uint32_t baud_rate = ((uint32_t)receive_byte() << 24);
+        baud_rate |= ((uint32_t)receive_byte() << 16);
+        baud_rate |= ((uint32_t)receive_byte() << 8);
+        baud_rate |= receive_byte();
+
+        if (!baud_rate_supported(baud_rate))
+        {
+            send_string_P(PSTR("Error: Unsupported baud rate.\n"));
+            break;
+        }
+
+        // Reply at the old rate, then switch
+        send_string_P(PSTR("Baud rate set to "));
+        send_decimal(baud_rate);
+        send_string_P(PSTR(".\n"));
+        switch_baud_rate(baud_rate);
+        break;
+    }
+
+    case 'P': // Select protocol
+    {
+        uint8_t mode = receive_byte();
+
+        if (mode == PROTOCOL_FRAMED)
+        {
+            send_string_P(PSTR("Protocol set to framed.\n"));
+            protocol_mode = PROTOCOL_FRAMED; // Following bytes are frames
+        }
+        else if (mode == PROTOCOL_LEGACY)
+        {
+            send_string_P(PSTR("Protocol set to legacy.\n"));
+        }
+        else
+        {
+            send_string_P(PSTR("Error: Invalid protocol.\n"));
+        }
+
+        break;
+    }
+
+    case 'G': // Get CPU registers, from the shadow if it is fully known
+    {
+        registers_t registers;
+
+        if (!read_shadow(&registers) && !read_registers(&registers))
+        {
+            send_string_P(PSTR("Error: Register access failed.\n"));
+            break;
+        }
+
+        send_string_P(PSTR("A="));
+        send_byte_hex(registers.a);
+        send_string_P(PSTR(" X="));
+        send_byte_hex(registers.x);
+        send_string_P(PSTR(" Y="));
+        send_byte_hex(registers.y);
+        send_string_P(PSTR(" SP="));
+        send_byte_hex(registers.sp);
+        send_string_P(PSTR(" P="));
+        send_byte_hex(registers.p);
+        send_string_P(PSTR(" PC="));
+        send_byte_hex(registers.pc >> 8);
+        send_byte_hex(registers.pc & 0xFF);
+        send_string_P(PSTR("\n"));
+        break;
+    }
+
+    case 'J': // Set CPU registers
+    {
+        // Read A, X, Y, SP, P (1 byte each) and PC (2 bytes)
+        registers_t registers;
+
+        registers.a = receive_byte();
+        registers.x = receive_byte();
+        registers.y = receive_byte();
+        registers.sp = receive_byte();
+        registers.p = receive_byte();
+        registers.pc = ((uint16_t)receive_byte() << 8) | receive_byte();
+
+        if (write_registers(&registers))
+        {
+            send_string_P(PSTR("Registers written.\n"));
+        }
+        else
+        {
+            send_string_P(PSTR("Error: Register access failed.\n"));
+        }
+
+        break;
+    }
+
+    case 'O': // Follow the registers from bus traffic
+    {
+        uint8_t enable = receive_byte();
+
+        if (enable)
+        {
+            start_shadow();
+            send_string_P(PSTR("Shadow registers on.\n"));
+        }
+        else
+        {
+            stop_shadow();
+            send_string_P(PSTR("Shadow registers off.\n"));
+        }
+
+        break;
+    }
+
+    case 'I': // Read the performance counters
     {
-        send_byte(*str++);
+        static const char names[STATS_COUNTERS][15] PROGMEM = {
+            "Cycles=", " Instructions=", " Reads=", " Writes=",
+            " IRQs=", " NMIs=", " Hits=", " Unmapped=",
+        };
+        uint8_t reset = receive_byte();
+        uint32_t counters[STATS_COUNTERS];
+
+        read_stats(counters);
+
+        if (reset)
+        {
+            reset_stats();
+        }
+
+        for (uint8_t i = 0; i < STATS_COUNTERS; i++)
+        {
+            send_string_P(names[i]);
+
+            if (counters[i] == STAT_UNAVAILABLE)
+            {
+                send_string_P(PSTR("n/a"));
+            }
+            else
+            {
+                send_decimal(counters[i]);
+            }
+        }
+        send_string_P(PSTR("\n"));
+        break;
+    }
+
+    default:
+        // Unknown command
+        send_string_P(PSTR("Error: Unknown command.\n"));
+        break;
     }
 }
 
 /**
- * Calculate a simple checksum for data integrity verification.
+ * Store the payload bytes of an 'L' command that have arrived so far,
+ * or decode them for a 'Z' command. After an invalid address the rest
+ * of the payload is discarded so it is not mistaken for commands.
  */
-uint8_t calculate_checksum(uint8_t *data, uint16_t length)
+void continue_load(void)
 {
-    uint8_t checksum = 0;
+    while (load_remaining && serial_available())
+    {
+        uint8_t data = receive_byte();
+
+        if (!load_error && !(load_packed ? unpack_byte(data) : write_memory(load_address, data)))
+        {
+            send_string_P(PSTR("Error: Invalid address during load.\n"));
+            load_error = 1;
+        }
+
+        load_address++;
+        load_remaining--;
+    }
 
-    // Loop through each byte of the data array
-    for (uint16_t i = 0; i < length; i++)
+    if (!load_remaining && !load_error)
     {
-        checksum ^= data[i]; // XOR the current byte with the checksum
+        if (load_packed && !unpack_idle())
+        {
+            send_string_P(PSTR("Error: Truncated compressed data.\n"));
+        }
+        else
+        {
+            send_string_P(PSTR("Data loaded successfully.\n"));
+        }
     }
+}
+
+/**
+ * Reset the 6502 CPU.
+ */
+void reset_cpu(void)
+{
+    // Pull RESET low for a short time
+    CONTROL_PORT &= ~(1 << CPU_RESET);
+    _delay_ms(10);
+    CONTROL_PORT |= (1 << CPU_RESET);
+    cancel_run();
+    reset_generator();
+    reset_pia();
+    clear_shadow();
+    cpu_running = 1;
+}
+
+/**
+ * Halt the 6502 CPU by stopping memory simulation.
+ */
+void halt_cpu(void)
+{
+    cpu_running = 0;
+}
+
+/**
+ * Release the 6502 CPU to continue execution.
+ */
+void release_cpu(void)
+{
+    cancel_run();
+    cpu_running = 1;
+}
+
+/**
+ * Step the 6502 CPU by simulating one instruction.
+ * Stops at the instruction boundary, with the next opcode fetch not yet
+ * clocked, so register reads by injection start right there. If the CPU
+ * was halted in the middle of an instruction, that instruction completes.
+ */
+void step_cpu(void)
+{
+    uint8_t cycles = STEP_MAX_CYCLES;
+
+    // Halt the CPU to ensure control
+    cancel_run();
+    halt_cpu();
+
+    do
+    {
+        // Clock one cycle and service its memory access
+        bus_cycle();
 
-    return checksum;
+        // SYNC is already valid for the next cycle while PHI2 is low
+    } while (!(CONTROL_PIN & (1 << CPU_SYNC)) && --cycles);
 }
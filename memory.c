@@ -0,0 +1,332 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Page table maintenance and host-side memory access.
+ */
+
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+
+#include "breakpoint.h"
+#include "bus.h"
+#include "device.h"
+#include "irq.h"
+#include "memory.h"
+#include "pia.h"
+
+// ROM images (erom, from, rom). PROGMEM data is linked right after the
+// vector table, inside the first 64 KB of flash, so plain LPM reaches it.
+// The images are 256-byte aligned so that bus.S can serve them.
+#include "roms/rom.h"
+
+// Global variables
+#ifndef XMEM_SIZE_KB
+uint8_t memory[MEMORY_SIZE] __attribute__((aligned(256))); // Simulated 4KB of memory
+#endif
+uint8_t page_type[256];                                   // PAGE_* type per page
+page_base_t page_base[256];                               // Base pointer per page
+uint8_t bus_page_map[256] __attribute__((aligned(256)));  // Fast-path view for bus.S reads
+uint8_t bus_write_map[256] __attribute__((aligned(256))); // Fast-path view for bus.S writes
+uint8_t bus_rom_map[256] __attribute__((aligned(256)));   // Fast-path view for bus.S ROM reads
+uint8_t dirty_pages[32];                                  // Pages written since the last fetch
+const uint8_t page_bit_mask[8] = {0x01, 0x02, 0x04, 0x08,
+                                  0x10, 0x20, 0x40, 0x80};
+
+/**
+ * Set up the default memory map: 6502 RAM at $0000 (memory[], or the
+ * external SRAM in XMEM builds), the PIA at $D010, the ROM images at
+ * their native addresses, everything else unmapped. The Woz Monitor page
+ * at $FF00 overlays the last page of the $F000 image and holds the
+ * reset vector, so a reset boots straight into the monitor.
+ * Returns 1 if successful, 0 if a device could not be registered.
+ */
+uint8_t init_memory_map(void)
+{
+    uint8_t devices = 1;
+
+#ifdef XMEM_SIZE_KB
+    // Enable the external memory interface with no wait states
+    XMCRA = (1 << SRE);
+#if XMEM_SIZE_KB == 32
+    XMCRB = (1 << XMM0); // Release PC7, the chip only decodes A14..A0
+#else
+    XMCRB = 0x00;
+#endif
+#endif
+
+    unmap_pages(0x00, 0); // 0 pages means all 256
+    map_ram(0x00, MEMORY_SIZE / 256, MEMORY_BASE);
+    devices &= register_device(&pia_device); // Apple-1 PIA at $D010
+    devices &= register_device(&irq_device); // Interrupt generator status at $D100
+    map_rom(0xE0, sizeof(erom) / 256, erom); // Integer BASIC at $E000
+    map_rom(0xF0, sizeof(from) / 256, from); // $F000 image
+    map_rom(0xFF, sizeof(rom) / 256, rom);   // Woz Monitor at $FF00
+
+    return devices;
+}
+
+/**
+ * Map SRAM into the 6502 address space.
+ * The backing store must be 256-byte aligned for the assembly bus loop.
+ */
+void map_ram(uint8_t first_page, uint8_t pages, uint8_t *ram)
+{
+    uint8_t page = first_page;
+
+    do
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            page_type[page] = PAGE_RAM;
+            page_base[page].ram = ram;
+            update_bus_page(page);
+        }
+
+        ram += 256;
+        page++;
+    } while (--pages);
+}
+
+/**
+ * Map a PROGMEM image read-only into the 6502 address space.
+ * Reads are served with LPM straight from flash, costing no SRAM.
+ */
+void map_rom(uint8_t first_page, uint8_t pages, const uint8_t *rom)
+{
+    uint8_t page = first_page;
+
+    do
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            page_type[page] = PAGE_ROM;
+            page_base[page].rom = rom;
+            update_bus_page(page);
+        }
+
+        rom += 256;
+        page++;
+    } while (--pages);
+}
+
+/**
+ * Map an I/O handler over a range of pages. Peripherals go through
+ * register_device(), which calls this for the pages they decode.
+ */
+void map_io(uint8_t first_page, uint8_t pages, const io_handler_t *io)
+{
+    uint8_t page = first_page;
+
+    do
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            page_type[page] = PAGE_IO;
+            page_base[page].io = io;
+            update_bus_page(page);
+        }
+
+        page++;
+    } while (--pages);
+}
+
+/**
+ * Remove a range of pages from the address space (0 pages means all 256).
+ */
+void unmap_pages(uint8_t first_page, uint8_t pages)
+{
+    uint8_t page = first_page;
+
+    do
+    {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            page_type[page] = PAGE_UNMAPPED;
+            page_base[page].ram = 0;
+            update_bus_page(page);
+        }
+
+        page++;
+    } while (--pages);
+}
+
+/**
+ * Recompute the bus.S fast-path entries of a page. Only RAM pages, and
+ * reads of ROM pages at a 256-byte aligned flash address, are served by
+ * bus.S, unless they hold breakpoints or watchpoints; everything else
+ * needs the C service. Writes to a page are only served once it is
+ * dirty, so that bus_write() sees the first one.
+ */
+void update_bus_page(uint8_t page)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        uint8_t fast = !breakpoint_in_page(page) && !watchpoint_in_page(page) &&
+                       !generator_in_page(page);
+
+        bus_page_map[page] = 0;
+        bus_rom_map[page] = 0;
+
+        if (fast && page_type[page] == PAGE_RAM)
+        {
+            bus_page_map[page] = (uintptr_t)page_base[page].ram >> 8;
+        }
+        else if (fast && page_type[page] == PAGE_ROM && !((uintptr_t)page_base[page].rom & 0xFF))
+        {
+            bus_rom_map[page] = (uintptr_t)page_base[page].rom >> 8;
+        }
+
+        bus_write_map[page] = page_dirty(page) ? bus_page_map[page] : 0;
+    }
+}
+
+/**
+ * Mark a page as written, and let bus.S serve further writes to it.
+ */
+void mark_page_dirty(uint8_t page)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        dirty_pages[page >> 3] |= page_bit_mask[page & 7];
+        update_bus_page(page);
+    }
+}
+
+/**
+ * Copy the dirty-page bitmap into pages (32 bytes) and clear it.
+ * Pages written after this call are marked again, so none are missed
+ * as long as the caller reads the pages after taking the bitmap.
+ */
+void take_dirty_pages(uint8_t *pages)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        for (uint8_t i = 0; i < 32; i++)
+        {
+            pages[i] = dirty_pages[i];
+            dirty_pages[i] = 0;
+        }
+    }
+
+    // Trap the next write to each of them again
+    uint8_t page = 0;
+
+    do
+    {
+        if (pages[page >> 3] & page_bit_mask[page & 7])
+        {
+            update_bus_page(page);
+        }
+    } while (++page);
+}
+
+/**
+ * Write a byte to memory at the specified address.
+ * Returns 1 if successful, 0 if the address is not mapped to RAM.
+ */
+uint8_t write_memory(uint16_t address, uint8_t data)
+{
+    uint8_t page = address >> 8;
+
+    if (page_type[page] == PAGE_RAM)
+    {
+        page_base[page].ram[address & 0xFF] = data;
+
+        if (!page_dirty(page))
+        {
+            mark_page_dirty(page);
+        }
+        return 1;
+    }
+    else
+    {
+        return 0; // ROM, I/O or unmapped
+    }
+}
+
+/**
+ * Read a byte from memory at the specified address.
+ * I/O pages are not read, so host access never has side effects.
+ * Returns 1 if successful, 0 if the address is not mapped to RAM or ROM.
+ */
+uint8_t read_memory(uint16_t address, uint8_t *data)
+{
+    uint8_t page = address >> 8;
+
+    switch (page_type[page])
+    {
+    case PAGE_RAM:
+    case PAGE_ROM:
+        *data = bus_read(address);
+        return 1;
+    default:
+        *data = 0xFF; // Default value
+        return 0;     // I/O or unmapped
+    }
+}
+
+/**
+ * Check that a range of pages can be read by the host (0 pages means all
+ * 256). Only RAM and ROM qualify, so host reads never reach I/O devices.
+ */
+uint8_t pages_readable(uint8_t first_page, uint8_t pages)
+{
+    uint8_t page = first_page;
+
+    do
+    {
+        if (page_type[page] != PAGE_RAM && page_type[page] != PAGE_ROM)
+        {
+            return 0;
+        }
+
+        page++;
+    } while (--pages);
+
+    return 1;
+}
+
+/**
+ * Calculate the CRC-16/XMODEM of a block of SRAM.
+ */
+uint16_t calculate_checksum(const uint8_t *data, uint16_t length)
+{
+    uint16_t checksum = 0;
+
+    // Loop through each byte of the data array
+    for (uint16_t i = 0; i < length; i++)
+    {
+        checksum = _crc_xmodem_update(checksum, data[i]);
+    }
+
+    return checksum;
+}
+
+/**
+ * Hash a 256-byte page of 6502 memory, for the host to compare against
+ * its local image. Returns 1 on success, 0 if the page is not RAM or ROM.
+ */
+uint8_t hash_page(uint8_t page, uint16_t *hash)
+{
+    switch (page_type[page])
+    {
+    case PAGE_RAM:
+        *hash = calculate_checksum(page_base[page].ram, 256);
+        return 1;
+    case PAGE_ROM:
+    {
+        uint16_t checksum = 0;
+
+        for (uint16_t i = 0; i < 256; i++)
+        {
+            checksum = _crc_xmodem_update(checksum, pgm_read_byte(page_base[page].rom + i));
+        }
+
+        *hash = checksum;
+        return 1;
+    }
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,177 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * 6821 PIA registers on the 6502 bus, bridged to the host. The handlers
+ * run inside the bus service (possibly from the Timer1 ISR), the host
+ * side from the main loop; each FIFO has one producer and one consumer.
+ */
+
+#include <avr/io.h>
+
+#include "pia.h"
+
+// Register offsets
+#define REG_KBD         0
+#define REG_KBDCR       1
+#define REG_DSP         2
+#define REG_DSPCR       3
+
+// Control register bit selecting the data register (DDR when clear)
+#define CR_DATA         0x04
+
+#define KEYBOARD_MASK   (KEYBOARD_SIZE - 1)
+#define DISPLAY_MASK    (DISPLAY_SIZE - 1)
+
+// Global variables
+static uint8_t keyboard[KEYBOARD_SIZE];     // Keys from the host
+static volatile uint8_t keyboard_head = 0;
+static volatile uint8_t keyboard_tail = 0;
+static uint8_t display[DISPLAY_SIZE];       // Characters for the host
+static volatile uint8_t display_head = 0;
+static volatile uint8_t display_tail = 0;
+static uint8_t kbdcr;                       // Control registers as written
+static uint8_t dspcr;
+static uint8_t dsp;                         // Last character written to DSP
+
+static uint8_t pia_read(uint16_t address);
+static void pia_write(uint16_t address, uint8_t data);
+
+const device_t pia_device = {{pia_read, pia_write}, PIA_BASE, PIA_LAST};
+
+/**
+ * Return the PIA to its power-on state, as the 6502 RESET line does.
+ */
+void reset_pia(void)
+{
+    kbdcr = 0;
+    dspcr = 0;
+    dsp = 0;
+}
+
+/**
+ * Read a PIA register. Addresses outside $D010-$D013 read as 0xFF.
+ */
+static uint8_t pia_read(uint16_t address)
+{
+    if ((address & 0xFFFC) != PIA_BASE)
+    {
+        return 0xFF;
+    }
+
+    switch (address & 0x03)
+    {
+    case REG_KBD:
+        if (!(kbdcr & CR_DATA))
+        {
+            return 0x00; // DDRA: all inputs
+        }
+
+        if (keyboard_head != keyboard_tail)
+        {
+            // Reading the data register clears the key flag
+            uint8_t key = keyboard[keyboard_tail];
+            keyboard_tail = (keyboard_tail + 1) & KEYBOARD_MASK;
+            return key | 0x80;
+        }
+        return 0x80;
+
+    case REG_KBDCR:
+        return (kbdcr & 0x3F) | (keyboard_head != keyboard_tail ? 0x80 : 0x00);
+
+    case REG_DSP:
+        if (((display_head + 1) & DISPLAY_MASK) == display_tail)
+        {
+            return dsp | 0x80; // Busy until the host catches up
+        }
+        return dsp;
+
+    default: // REG_DSPCR
+        return dspcr & 0x3F;
+    }
+}
+
+/**
+ * Write a PIA register. Writes outside $D010-$D013 are ignored.
+ */
+static void pia_write(uint16_t address, uint8_t data)
+{
+    if ((address & 0xFFFC) != PIA_BASE)
+    {
+        return;
+    }
+
+    switch (address & 0x03)
+    {
+    case REG_KBDCR:
+        kbdcr = data;
+        break;
+
+    case REG_DSP:
+    {
+        // With DSPCR bit 2 clear the write sets DDRB, as the monitor does at reset
+        uint8_t next = (display_head + 1) & DISPLAY_MASK;
+
+        if ((dspcr & CR_DATA) && next != display_tail)
+        {
+            dsp = data & 0x7F;
+            display[display_head] = dsp;
+            display_head = next;
+        }
+        break;
+    }
+
+    case REG_DSPCR:
+        dspcr = data;
+        break;
+
+    default: // REG_KBD is an input port
+        break;
+    }
+}
+
+/**
+ * Queue a key from the host, as the Apple-1 keyboard would send it:
+ * upper case, with Return as CR.
+ * Returns 1 if successful, 0 if the keyboard FIFO is full.
+ */
+uint8_t pia_key(uint8_t key)
+{
+    uint8_t next = (keyboard_head + 1) & KEYBOARD_MASK;
+
+    if (next == keyboard_tail)
+    {
+        return 0;
+    }
+
+    if (key == '\n')
+    {
+        key = '\r';
+    }
+    else if (key >= 'a' && key <= 'z')
+    {
+        key -= 'a' - 'A';
+    }
+
+    keyboard[keyboard_head] = key & 0x7F;
+    keyboard_head = next;
+    return 1;
+}
+
+/**
+ * Return the number of display characters waiting for the host.
+ */
+uint8_t display_available(void)
+{
+    return (display_head - display_tail) & DISPLAY_MASK;
+}
+
+/**
+ * Take the next display character for the host.
+ * Only valid when display_available() is non-zero.
+ */
+uint8_t display_read(void)
+{
+    uint8_t data = display[display_tail];
+    display_tail = (display_tail + 1) & DISPLAY_MASK;
+    return data;
+}
@@ -0,0 +1,96 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Sampled PC profiler control and download.
+ */
+
+#include <avr/io.h>
+#include <string.h>
+#include <util/atomic.h>
+
+#include "profile.h"
+
+// Global variables
+volatile uint8_t profile_mode = PROFILE_STOP;
+uint16_t profile_counts[PROFILE_BUCKETS];   // Samples per bucket
+uint32_t profile_samples = 0;               // All samples, in the window or not
+uint16_t profile_base = 0;                  // Address of bucket 0
+uint8_t profile_shift = 0;                  // log2 of the bucket size
+uint16_t profile_period;                    // Instructions or cycles per sample
+uint16_t profile_next;
+static uint8_t profile_last_mode;           // Mode of the histogram, for the download
+
+/**
+ * Clear the histogram and start sampling.
+ * The period is in instructions, or in cycles (at most 32767) for
+ * PROFILE_CYCLES.
+ * Returns 1 if successful, 0 if the settings are invalid.
+ */
+uint8_t start_profile(uint8_t mode, uint16_t base, uint8_t shift, uint16_t period)
+{
+    if ((mode != PROFILE_INSTRUCTIONS && mode != PROFILE_CYCLES) ||
+        shift > PROFILE_MAX_SHIFT || period == 0 ||
+        (mode == PROFILE_CYCLES && period > 0x7FFF))
+    {
+        return 0;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memset(profile_counts, 0, sizeof(profile_counts));
+        profile_samples = 0;
+        profile_base = base;
+        profile_shift = shift;
+        profile_period = period;
+        profile_next = mode == PROFILE_CYCLES ? (uint16_t)cycle_count + period : period;
+        profile_last_mode = mode;
+        profile_mode = mode;
+    }
+
+    return 1;
+}
+
+/**
+ * Stop sampling. The histogram is kept for the download.
+ */
+void stop_profile(void)
+{
+    profile_mode = PROFILE_STOP;
+}
+
+/**
+ * Return the size in bytes of the profile download.
+ */
+uint16_t profile_length(void)
+{
+    return PROFILE_HEADER + 2 * PROFILE_BUCKETS;
+}
+
+/**
+ * Return one byte of the profile download (see profile.h for the layout).
+ * Only valid while sampling is stopped.
+ */
+uint8_t profile_byte(uint16_t offset)
+{
+    switch (offset)
+    {
+    case 0:
+        return profile_base >> 8;
+    case 1:
+        return profile_base & 0xFF;
+    case 2:
+        return profile_shift;
+    case 3:
+        return profile_last_mode;
+    case 4:
+    case 5:
+    case 6:
+    case 7:
+        return profile_samples >> (8 * (7 - offset));
+    default:
+    {
+        uint16_t count = profile_counts[(offset - PROFILE_HEADER) / 2];
+        return offset & 1 ? count & 0xFF : count >> 8;
+    }
+    }
+}
@@ -0,0 +1,870 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Framed binary protocol (v2): incremental frame parser, response
+ * framing and the command handlers for framed mode.
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+
+#include "breakpoint.h"
+#include "capture.h"
+#include "cpu.h"
+#include "irq.h"
+#include "memory.h"
+#include "pia.h"
+#include "profile.h"
+#include "protocol.h"
+#include "registers.h"
+#include "run.h"
+#include "serial.h"
+#include "shadow.h"
+#include "stats.h"
+#include "trace.h"
+#include "unpack.h"
+
+// Frame parser states
+#define STATE_SOF       0
+#define STATE_LENGTH    1
+#define STATE_SEQ       2
+#define STATE_COMMAND   3
+#define STATE_PAYLOAD   4
+#define STATE_CRC_HIGH  5
+#define STATE_CRC_LOW   6
+
+// Block dump sources
+#define SOURCE_MEMORY   0 // 6502 memory ('X', 'U')
+#define SOURCE_TRACE    1 // Instruction trace ('T')
+#define SOURCE_CAPTURE  2 // Logic-analyzer capture ('Y')
+#define SOURCE_PROFILE  3 // Profiler histogram ('p')
+#define SOURCE_HASH     4 // Page hashes ('Q')
+
+// Global variables
+uint8_t protocol_mode = PROTOCOL_LEGACY;
+uint8_t dump_active = 0;
+
+static uint8_t state = STATE_SOF;           // Parser state
+static uint8_t frame_length;                // Payload length of the frame being parsed
+static uint8_t frame_seq;                   // Sequence number of the frame being parsed
+static uint8_t frame_command;               // Command of the frame being parsed
+static uint8_t frame_payload[FRAME_MAX_PAYLOAD];
+static uint8_t frame_count;                 // Payload bytes received so far
+static uint16_t frame_crc;                  // CRC of the frame being parsed
+static uint16_t frame_received_crc;         // CRC sent by the host
+static uint16_t response_crc;               // CRC of the response being sent
+static uint16_t dump_address;               // Next address of the block dump
+static uint16_t dump_remaining;             // Bytes of the block dump still to send
+static uint16_t dump_crc;                   // CRC of the data dumped so far
+static uint8_t dump_seq;                    // SEQ of the 'X' or 'U' request being answered
+static uint8_t dump_header;                 // Set until the bitmap of a 'U' is sent
+static uint8_t dump_pages[32];              // Dirty pages still to send for 'U'
+static uint8_t dump_source;                 // SOURCE_* that dump_address indexes
+
+static void execute_frame(void);
+
+/**
+ * Start a response frame. The caller sends exactly length payload bytes
+ * with frame_byte() and closes the frame with frame_end().
+ */
+void frame_begin(uint8_t seq, uint8_t status, uint8_t length)
+{
+    send_byte(FRAME_SOF);
+    response_crc = 0;
+    frame_byte(length);
+    frame_byte(seq);
+    frame_byte(status);
+}
+
+/**
+ * Send one byte of a response frame.
+ */
+void frame_byte(uint8_t data)
+{
+    response_crc = _crc_xmodem_update(response_crc, data);
+    send_byte(data);
+}
+
+/**
+ * Close a response frame by sending its CRC.
+ */
+void frame_end(void)
+{
+    send_byte(response_crc >> 8);
+    send_byte(response_crc & 0xFF);
+}
+
+/**
+ * Send a complete response frame.
+ */
+void send_frame(uint8_t seq, uint8_t status, const uint8_t *payload, uint8_t length)
+{
+    frame_begin(seq, status, length);
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        frame_byte(payload[i]);
+    }
+
+    frame_end();
+}
+
+/**
+ * Start streaming a block of 6502 memory to the host.
+ * The whole range must be RAM or ROM, as for 'M', so that reading it has
+ * no side effects on I/O devices.
+ * Returns 1 if the dump was started, 0 if the range is invalid.
+ */
+uint8_t start_dump(uint16_t address, uint16_t length, uint8_t seq)
+{
+    if ((uint32_t)address + length > 0x10000)
+    {
+        return 0;
+    }
+
+    if (length)
+    {
+        uint8_t first_page = address >> 8;
+        uint8_t last_page = (address + length - 1) >> 8;
+
+        if (!pages_readable(first_page, last_page - first_page + 1))
+        {
+            return 0;
+        }
+    }
+
+    dump_address = address;
+    dump_remaining = length;
+    dump_crc = 0;
+    dump_seq = seq;
+    dump_source = SOURCE_MEMORY;
+    dump_active = 1;
+    return 1;
+}
+
+/**
+ * Stop the instruction trace and start streaming it (see trace.h).
+ */
+void start_trace_dump(uint8_t seq)
+{
+    stop_trace();
+    start_dump(0, 0, seq);
+    dump_remaining = trace_length();
+    dump_source = SOURCE_TRACE;
+}
+
+/**
+ * Start streaming a complete logic-analyzer capture (see capture.h).
+ */
+void start_capture_dump(uint8_t seq)
+{
+    capture_state = CAPTURE_READY; // Reading it is as good as the report
+    start_dump(0, 0, seq);
+    dump_remaining = capture_length();
+    dump_source = SOURCE_CAPTURE;
+}
+
+/**
+ * Stop the profiler and start streaming its histogram (see profile.h).
+ */
+void start_profile_dump(uint8_t seq)
+{
+    stop_profile();
+    start_dump(0, 0, seq);
+    dump_remaining = profile_length();
+    dump_source = SOURCE_PROFILE;
+}
+
+/**
+ * Start streaming the hashes of a range of pages ('Q'), 2 bytes each,
+ * big-endian. A page count of 0 means 256. The caller checks that the
+ * pages are readable.
+ */
+void start_hash_dump(uint8_t first_page, uint8_t pages, uint8_t seq)
+{
+    start_dump(0, 0, seq);
+    dump_address = (uint16_t)first_page * 2;
+    dump_remaining = (pages ? pages : 256) * 2;
+    dump_source = SOURCE_HASH;
+}
+
+/**
+ * Return one byte of the page hashes, where offset 2n is the high byte
+ * of the hash of page n. A page is hashed when its high byte is asked for.
+ */
+static uint8_t hash_byte(uint16_t offset)
+{
+    static uint16_t hash;
+
+    if (!(offset & 1))
+    {
+        hash_page(offset >> 1, &hash);
+        return hash >> 8;
+    }
+
+    return hash & 0xFF;
+}
+
+/**
+ * Start streaming the pages written since the last call: the 32-byte
+ * dirty-page bitmap, then the contents of each dirty page in order.
+ * The bitmap is cleared, so the next call returns only newer changes.
+ */
+void start_dirty_dump(uint8_t seq)
+{
+    take_dirty_pages(dump_pages);
+    start_dump(0, 0, seq);
+    dump_header = 1;
+}
+
+/**
+ * Send a chunk of dump data, framed or raw, and add it to the CRC.
+ */
+static void send_dump_data(const uint8_t *data, uint8_t count)
+{
+    if (protocol_mode == PROTOCOL_FRAMED)
+    {
+        frame_begin(dump_seq, STATUS_MORE, count);
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        dump_crc = _crc_xmodem_update(dump_crc, data[i]);
+
+        if (protocol_mode == PROTOCOL_FRAMED)
+        {
+            frame_byte(data[i]);
+        }
+        else
+        {
+            send_byte(data[i]);
+        }
+    }
+
+    if (protocol_mode == PROTOCOL_FRAMED)
+    {
+        frame_end();
+    }
+}
+
+/**
+ * Send the next chunk of the block dump in progress ('X', 'U', 'T', 'Y',
+ * 'p' or 'Q'), followed by the trailing CRC once all the data is out.
+ * A chunk is only produced when the transmit buffer can take all of it,
+ * so the main loop keeps servicing the bus instead of waiting on the
+ * link. In legacy mode the data and the CRC are sent as raw bytes.
+ */
+void continue_dump(void)
+{
+    uint8_t chunk[DUMP_CHUNK];
+
+    if (dump_header)
+    {
+        if (serial_tx_free() >= sizeof(dump_pages) + FRAME_OVERHEAD)
+        {
+            send_dump_data(dump_pages, sizeof(dump_pages));
+            dump_header = 0;
+        }
+        return;
+    }
+
+    // Move on to the next dirty page of a 'U'
+    if (!dump_remaining)
+    {
+        for (uint8_t i = 0; i < sizeof(dump_pages); i++)
+        {
+            if (dump_pages[i])
+            {
+                uint8_t bit = 0;
+
+                while (!(dump_pages[i] & page_bit_mask[bit]))
+                {
+                    bit++;
+                }
+
+                dump_pages[i] &= ~page_bit_mask[bit];
+                dump_address = (uint16_t)(i * 8 + bit) << 8;
+                dump_remaining = 256;
+                break;
+            }
+        }
+    }
+
+    uint8_t count = dump_remaining < DUMP_CHUNK ? dump_remaining : DUMP_CHUNK;
+
+    // Hashing is slow, so only a few pages go per main loop pass
+    if (dump_source == SOURCE_HASH && count > HASH_CHUNK)
+    {
+        count = HASH_CHUNK;
+    }
+
+    if (serial_tx_free() < count + FRAME_OVERHEAD)
+    {
+        return;
+    }
+
+    if (count)
+    {
+        for (uint8_t i = 0; i < count; i++)
+        {
+            switch (dump_source)
+            {
+            case SOURCE_TRACE:
+                chunk[i] = trace_byte(dump_address++);
+                break;
+            case SOURCE_CAPTURE:
+                chunk[i] = capture_byte(dump_address++);
+                break;
+            case SOURCE_PROFILE:
+                chunk[i] = profile_byte(dump_address++);
+                break;
+            case SOURCE_HASH:
+                chunk[i] = hash_byte(dump_address++);
+                break;
+            default:
+                read_memory(dump_address++, &chunk[i]);
+                break;
+            }
+        }
+
+        send_dump_data(chunk, count);
+        dump_remaining -= count;
+        return;
+    }
+
+    uint8_t crc[2] = {dump_crc >> 8, dump_crc & 0xFF};
+
+    if (protocol_mode == PROTOCOL_FRAMED)
+    {
+        send_frame(dump_seq, STATUS_OK, crc, sizeof(crc));
+    }
+    else
+    {
+        send_byte(crc[0]);
+        send_byte(crc[1]);
+    }
+
+    dump_active = 0;
+}
+
+/**
+ * Feed received bytes to the frame parser and execute complete frames.
+ * Never blocks; a partial frame is kept until the rest arrives.
+ */
+void handle_frame_input(void)
+{
+    while (serial_available())
+    {
+        uint8_t data = receive_byte();
+
+        switch (state)
+        {
+        case STATE_SOF:
+            if (data == FRAME_SOF)
+            {
+                frame_crc = 0;
+                state = STATE_LENGTH;
+            }
+            break; // Anything else is noise between frames
+
+        case STATE_LENGTH:
+            frame_length = data;
+            frame_count = 0;
+            frame_crc = _crc_xmodem_update(frame_crc, data);
+            state = STATE_SEQ;
+            break;
+
+        case STATE_SEQ:
+            frame_seq = data;
+            frame_crc = _crc_xmodem_update(frame_crc, data);
+            state = STATE_COMMAND;
+            break;
+
+        case STATE_COMMAND:
+            frame_command = data;
+            frame_crc = _crc_xmodem_update(frame_crc, data);
+            state = frame_length ? STATE_PAYLOAD : STATE_CRC_HIGH;
+            break;
+
+        case STATE_PAYLOAD:
+            // Oversized payloads are counted but not stored
+            if (frame_count < FRAME_MAX_PAYLOAD)
+            {
+                frame_payload[frame_count] = data;
+            }
+
+            frame_crc = _crc_xmodem_update(frame_crc, data);
+
+            if (++frame_count == frame_length)
+            {
+                state = STATE_CRC_HIGH;
+            }
+            break;
+
+        case STATE_CRC_HIGH:
+            frame_received_crc = (uint16_t)data << 8;
+            state = STATE_CRC_LOW;
+            break;
+
+        case STATE_CRC_LOW:
+            frame_received_crc |= data;
+            state = STATE_SOF;
+
+            if (frame_received_crc != frame_crc)
+            {
+                send_frame(frame_seq, STATUS_BAD_CRC, 0, 0);
+            }
+            else if (frame_length > FRAME_MAX_PAYLOAD)
+            {
+                send_frame(frame_seq, STATUS_BAD_LENGTH, 0, 0);
+            }
+            else
+            {
+                execute_frame();
+            }
+
+            // Leave the rest for the next call if the mode changed
+            if (protocol_mode != PROTOCOL_FRAMED)
+            {
+                return;
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * Read a big-endian 16-bit value from the request payload.
+ */
+static uint16_t payload_word(uint8_t offset)
+{
+    return ((uint16_t)frame_payload[offset] << 8) | frame_payload[offset + 1];
+}
+
+/**
+ * Execute a complete, CRC-checked request frame and send its response.
+ */
+static void execute_frame(void)
+{
+    static const uint8_t lengths[][2] PROGMEM = {
+        {'R', 0}, {'H', 0}, {'C', 0}, {'S', 0}, {'W', 3}, {'M', 2}, {'B', 2},
+        {'D', 2}, {'A', 4}, {'E', 2}, {'F', 4}, {'N', 4}, {'P', 1}, {'G', 0},
+        {'X', 4}, {'Q', 2}, {'U', 0}, {'T', 1},
+        {'V', 9}, {'Y', 0}, {'J', 7}, {'O', 1}, {'I', 1}, {'p', 6}, {'s', 3}, {'i', 6},
+    };
+    uint8_t status = STATUS_OK;
+    uint8_t response[7];
+    uint8_t response_length = 0;
+
+    // Fixed-length commands; 'L' and 'Z' carry an address and 1 or more
+    // data bytes, 'K' 1 or more keys
+    if (frame_command == 'L' || frame_command == 'Z')
+    {
+        if (frame_length < 3)
+        {
+            status = STATUS_BAD_LENGTH;
+        }
+    }
+    else if (frame_command == 'K')
+    {
+        if (frame_length < 1)
+        {
+            status = STATUS_BAD_LENGTH;
+        }
+    }
+    else
+    {
+        status = STATUS_UNKNOWN_COMMAND;
+
+        for (uint8_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+        {
+            if (pgm_read_byte(&lengths[i][0]) == frame_command)
+            {
+                status = pgm_read_byte(&lengths[i][1]) == frame_length ? STATUS_OK : STATUS_BAD_LENGTH;
+                break;
+            }
+        }
+    }
+
+    if (status != STATUS_OK)
+    {
+        send_frame(frame_seq, status, 0, 0);
+        return;
+    }
+
+    switch (frame_command)
+    {
+    case 'R': // Reset CPU
+        reset_cpu();
+        break;
+
+    case 'H': // Halt CPU
+        cancel_run();
+        halt_cpu();
+        break;
+
+    case 'C': // Continue CPU
+        release_cpu();
+        break;
+
+    case 'S': // Step CPU
+        step_cpu();
+        break;
+
+    case 's': // Batched step: mode, count or address; answered when it stops
+        if (run_state != RUN_IDLE)
+        {
+            status = STATUS_BUSY;
+        }
+        else if (!start_run(frame_payload[0], payload_word(1), frame_seq))
+        {
+            status = STATUS_INVALID_ARGUMENT;
+        }
+        else
+        {
+            return; // send_run_result() sends the response
+        }
+        break;
+
+    case 'i': // IRQ/NMI generator: line, mode, period or address
+        if (!set_generator(frame_payload[0], frame_payload[1],
+                           ((uint32_t)payload_word(2) << 16) | payload_word(4)))
+        {
+            status = STATUS_INVALID_ARGUMENT;
+        }
+        break;
+
+    case 'W': // Write memory: address, data
+        if (!write_memory(payload_word(0), frame_payload[2]))
+        {
+            status = STATUS_INVALID_ADDRESS;
+        }
+        break;
+
+    case 'M': // Read memory: address, returns the data byte
+        if (!read_memory(payload_word(0), &response[0]))
+        {
+            status = STATUS_INVALID_ADDRESS;
+        }
+        response_length = 1;
+        break;
+
+    case 'L': // Load data into memory: address, data...
+    {
+        uint16_t address = payload_word(0);
+
+        for (uint8_t i = 2; i < frame_length; i++)
+        {
+            if (!write_memory(address++, frame_payload[i]))
+            {
+                status = STATUS_INVALID_ADDRESS;
+                break;
+            }
+        }
+        break;
+    }
+
+    case 'Z': // Load compressed data: address, whole tokens
+        unpack_begin(payload_word(0));
+
+        for (uint8_t i = 2; i < frame_length; i++)
+        {
+            if (!unpack_byte(frame_payload[i]))
+            {
+                status = STATUS_INVALID_ADDRESS;
+                break;
+            }
+        }
+
+        if (status == STATUS_OK && !unpack_idle())
+        {
+            status = STATUS_INVALID_ARGUMENT; // Token cut at the end of the frame
+        }
+        break;
+
+    case 'K': // Keys for the PIA keyboard: returns how many were queued
+        response[0] = 0;
+
+        while (response[0] < frame_length && pia_key(frame_payload[response[0]]))
+        {
+            response[0]++;
+        }
+
+        if (response[0] < frame_length)
+        {
+            status = STATUS_FULL;
+        }
+        response_length = 1;
+        break;
+
+    case 'B': // Set breakpoint: address
+        if (!add_breakpoint(payload_word(0)))
+        {
+            status = STATUS_FULL;
+        }
+        break;
+
+    case 'D': // Delete breakpoint: address
+        if (!remove_breakpoint(payload_word(0)))
+        {
+            status = STATUS_NOT_FOUND;
+        }
+        break;
+
+    case 'A': // Add watchpoint: address, flags, value
+        if (!add_watchpoint(payload_word(0), frame_payload[2], frame_payload[3]))
+        {
+            status = STATUS_INVALID_ARGUMENT;
+        }
+        break;
+
+    case 'E': // Erase watchpoint: address
+        if (!remove_watchpoint(payload_word(0)))
+        {
+            status = STATUS_NOT_FOUND;
+        }
+        break;
+
+    case 'F': // Set clock frequency: Hz, returns the frequency reached and the bypass flag
+    {
+        uint32_t frequency = ((uint32_t)payload_word(0) << 16) | payload_word(2);
+
+        if (!set_clock_frequency(frequency))
+        {
+            status = STATUS_INVALID_ARGUMENT;
+        }
+
+        response[0] = clock_frequency >> 24;
+        response[1] = clock_frequency >> 16;
+        response[2] = clock_frequency >> 8;
+        response[3] = clock_frequency & 0xFF;
+        response[4] = bus_loop_bypassed();
+        response_length = 5;
+        break;
+    }
+
+    case 'N': // Negotiate baud rate: switched after the response is sent
+        if (!baud_rate_supported(((uint32_t)payload_word(0) << 16) | payload_word(2)))
+        {
+            status = STATUS_INVALID_ARGUMENT;
+        }
+        break;
+
+    case 'X': // Dump memory: address, length; the data frames follow
+        if (dump_active)
+        {
+            status = STATUS_BUSY;
+        }
+        else if (start_dump(payload_word(0), payload_word(2), frame_seq))
+        {
+            return; // continue_dump() sends the response
+        }
+        else
+        {
+            status = STATUS_INVALID_ADDRESS;
+        }
+        break;
+
+    case 'U': // Fetch and clear dirty pages; the data frames follow
+        if (dump_active)
+        {
+            status = STATUS_BUSY;
+            break;
+        }
+
+        start_dirty_dump(frame_seq);
+        return; // continue_dump() sends the response
+
+    case 'T': // Trace control: mode; reading streams the buffer
+        if (frame_payload[0] == TRACE_START)
+        {
+            start_trace();
+        }
+        else if (frame_payload[0] == TRACE_STOP)
+        {
+            stop_trace();
+        }
+        else if (frame_payload[0] != TRACE_READ)
+        {
+            status = STATUS_INVALID_ARGUMENT;
+        }
+        else if (dump_active)
+        {
+            status = STATUS_BUSY;
+        }
+        else
+        {
+            start_trace_dump(frame_seq);
+            return; // continue_dump() sends the response
+        }
+        break;
+
+    case 'p': // Profiler: mode, base, bucket shift, period; reading streams the histogram
+        if (frame_payload[0] == PROFILE_STOP)
+        {
+            stop_profile();
+        }
+        else if (frame_payload[0] == PROFILE_READ)
+        {
+            if (dump_active)
+            {
+                status = STATUS_BUSY;
+                break;
+            }
+
+            start_profile_dump(frame_seq);
+            return; // continue_dump() sends the response
+        }
+        else if (!start_profile(frame_payload[0], payload_word(1), frame_payload[3],
+                                payload_word(4)))
+        {
+            status = STATUS_INVALID_ARGUMENT;
+        }
+        break;
+
+    case 'V': // Arm capture: low, high, value, mask, access, pre, post
+        if (!frame_payload[6])
+        {
+            disarm_capture(); // No access types: disarm
+        }
+        else if (!arm_capture(payload_word(0), payload_word(2), frame_payload[4],
+                              frame_payload[5], frame_payload[6], frame_payload[7],
+                              frame_payload[8]))
+        {
+            status = STATUS_INVALID_ARGUMENT;
+        }
+        break;
+
+    case 'Y': // Read capture; the data frames follow
+        if (capture_state == CAPTURE_IDLE)
+        {
+            status = STATUS_NOT_FOUND;
+        }
+        else if (capture_recording() || dump_active)
+        {
+            status = STATUS_BUSY;
+        }
+        else
+        {
+            start_capture_dump(frame_seq);
+            return; // continue_dump() sends the response
+        }
+        break;
+
+    case 'Q': // Query page hashes: first page, page count; the data frames follow
+    {
+        uint8_t first_page = frame_payload[0];
+        uint8_t pages = frame_payload[1];
+
+        if (first_page + (pages ? pages : 256) > 256)
+        {
+            status = STATUS_INVALID_ARGUMENT;
+        }
+        else if (!pages_readable(first_page, pages))
+        {
+            status = STATUS_INVALID_ADDRESS;
+        }
+        else if (dump_active)
+        {
+            status = STATUS_BUSY;
+        }
+        else
+        {
+            start_hash_dump(first_page, pages, frame_seq);
+            return; // continue_dump() sends the response
+        }
+        break;
+    }
+
+    case 'P': // Select protocol: the response is still framed
+        if (frame_payload[0] > PROTOCOL_FRAMED)
+        {
+            status = STATUS_INVALID_ARGUMENT;
+        }
+        break;
+
+    case 'G': // Get CPU registers: returns A, X, Y, SP, P and PC
+    {
+        registers_t registers;
+
+        if (!read_shadow(&registers) && !read_registers(&registers))
+        {
+            status = STATUS_UNSUPPORTED; // Injection failed
+            break;
+        }
+
+        response[0] = registers.a;
+        response[1] = registers.x;
+        response[2] = registers.y;
+        response[3] = registers.sp;
+        response[4] = registers.p;
+        response[5] = registers.pc >> 8;
+        response[6] = registers.pc & 0xFF;
+        response_length = 7;
+        break;
+    }
+
+    case 'J': // Set CPU registers: A, X, Y, SP, P and PC
+    {
+        registers_t registers = {
+            frame_payload[0], frame_payload[1], frame_payload[2],
+            frame_payload[3], frame_payload[4], payload_word(5),
+        };
+
+        if (!write_registers(&registers))
+        {
+            status = STATUS_UNSUPPORTED;
+        }
+        break;
+    }
+
+    case 'O': // Shadow registers on (non-zero) or off
+        if (frame_payload[0])
+        {
+            start_shadow();
+        }
+        else
+        {
+            stop_shadow();
+        }
+        break;
+
+    case 'I': // Performance counters, reset after reading if non-zero
+    {
+        uint32_t counters[STATS_COUNTERS];
+
+        read_stats(counters);
+
+        if (frame_payload[0])
+        {
+            reset_stats();
+        }
+
+        frame_begin(frame_seq, STATUS_OK, STATS_COUNTERS * 4);
+
+        for (uint8_t i = 0; i < STATS_COUNTERS; i++)
+        {
+            frame_byte(counters[i] >> 24);
+            frame_byte(counters[i] >> 16);
+            frame_byte(counters[i] >> 8);
+            frame_byte(counters[i] & 0xFF);
+        }
+
+        frame_end();
+        return;
+    }
+    }
+
+    send_frame(frame_seq, status, response, response_length);
+
+    if (frame_command == 'P' && status == STATUS_OK)
+    {
+        protocol_mode = frame_payload[0];
+    }
+
+    if (frame_command == 'N' && status == STATUS_OK)
+    {
+        switch_baud_rate(((uint32_t)payload_word(0) << 16) | payload_word(2));
+    }
+}
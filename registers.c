@@ -0,0 +1,214 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Opcode injection engine for register access. The stub is clocked
+ * cycle by cycle with PHI2 driven directly, bypassing the page table.
+ */
+
+#include <avr/io.h>
+
+#include "pins.h"
+#include "cpu.h"
+#include "irq.h"
+#include "registers.h"
+#include "shadow.h"
+
+/**
+ * Halt the CPU and clock it, serviced from memory as usual, until the
+ * next cycle is an opcode fetch. The address of that fetch (the PC) is
+ * already on the bus while PHI2 is low.
+ * Returns 1 if successful, 0 if no opcode fetch came up.
+ */
+static uint8_t next_fetch(uint16_t *pc)
+{
+    uint8_t wait = INJECT_MAX_WAIT;
+
+    halt_cpu();
+
+    while (!(CONTROL_PIN & (1 << CPU_SYNC)))
+    {
+        if (!--wait)
+        {
+            return 0;
+        }
+        bus_cycle();
+    }
+
+    *pc = ((uint16_t)ADDR_BUS_HIGH << 8) | ADDR_BUS_LOW;
+    return 1;
+}
+
+/**
+ * Clock an instruction stub in place of the code at pc, which must be
+ * the next opcode fetch. Reads of pc + n are answered with stub[n],
+ * stack reads with registers->p and any other read with NOP. Writes are
+ * snooped into registers and discarded. The stub ends with the read of
+ * its last byte (a JMP operand), which leaves the CPU before the opcode
+ * fetch at the JMP target. If the 6502 had already committed to an
+ * interrupt, its second cycle reads pc again where every stub reads
+ * pc + 1; the stub is abandoned there with PHI2 low, and the bus service
+ * takes the interrupt on from the next cycle clocked.
+ * Returns 1 if successful, 0 if the stub did not complete.
+ */
+static uint8_t run_stub(uint16_t pc, const uint8_t *stub, uint8_t length,
+                        registers_t *registers)
+{
+    uint8_t cycles = INJECT_MAX_CYCLES;
+
+    do
+    {
+        // The address is already valid while PHI2 is low
+        uint16_t address = ((uint16_t)ADDR_BUS_HIGH << 8) | ADDR_BUS_LOW;
+        uint16_t offset = address - pc;
+
+        if (cycles == INJECT_MAX_CYCLES - 1 && offset == 0)
+        {
+            return 0; // Interrupt sequence, not the stub
+        }
+
+        CONTROL_PORT |= (1 << CPU_CLOCK); // PHI2 high
+
+        if (CONTROL_PIN & (1 << CPU_RW))
+        {
+            if (offset < length)
+            {
+                DATA_BUS = stub[offset];
+            }
+            else if ((address >> 8) == 0x01)
+            {
+                DATA_BUS = registers->p; // PLP
+            }
+            else
+            {
+                DATA_BUS = 0xEA; // NOP, for dummy reads
+            }
+            DATA_DIR = 0xFF;
+        }
+        else
+        {
+            uint8_t data = DATA_PIN;
+
+            if ((address >> 8) == 0x01)
+            {
+                // PHP: pushed at $0100 + SP, before SP is decremented
+                registers->p = data;
+                registers->sp = address & 0xFF;
+            }
+            else if (address == SNOOP_A)
+            {
+                registers->a = data;
+            }
+            else if (address == SNOOP_X)
+            {
+                registers->x = data;
+            }
+            else if (address == SNOOP_Y)
+            {
+                registers->y = data;
+            }
+        }
+
+        CONTROL_PORT &= ~(1 << CPU_CLOCK); // PHI2 low
+        DATA_DIR = 0x00;
+
+        if (offset == length - 1 && (CONTROL_PIN & (1 << CPU_SYNC)))
+        {
+            return 1; // JMP done, its target is fetched next
+        }
+    } while (--cycles);
+
+    return 0;
+}
+
+/**
+ * Read A, X, Y, SP, P and PC of the CPU, which is halted. If it is in
+ * the middle of an instruction (after a breakpoint), that instruction
+ * completes first. P reads with the B and unused bits set, as pushed.
+ * The interrupt generator is suspended for the injection.
+ * Returns 1 if successful, 0 if the injection failed or NMI is asserted.
+ */
+uint8_t read_registers(registers_t *registers)
+{
+    uint8_t generator;
+    uint16_t pc;
+
+    if (!suspend_generator(&generator))
+    {
+        return 0;
+    }
+
+    if (!next_fetch(&pc))
+    {
+        resume_generator(generator);
+        return 0;
+    }
+
+    const uint8_t stub[] = {
+        0x08,                                   // PHP
+        0x28,                                   // PLP, pulls P back
+        0x8D, SNOOP_A & 0xFF, SNOOP_A >> 8,     // STA SNOOP_A
+        0x8E, SNOOP_X & 0xFF, SNOOP_X >> 8,     // STX SNOOP_X
+        0x8C, SNOOP_Y & 0xFF, SNOOP_Y >> 8,     // STY SNOOP_Y
+        0x4C, pc & 0xFF, pc >> 8,               // JMP back to the PC
+    };
+
+    registers->pc = pc;
+
+    uint8_t done = run_stub(pc, stub, sizeof(stub), registers);
+
+    resume_generator(generator);
+
+    if (!done)
+    {
+        return 0;
+    }
+
+    set_shadow(registers);
+    return 1;
+}
+
+/**
+ * Load A, X, Y, SP, P and PC into the CPU, which is halted before the
+ * opcode fetch at the new PC. The interrupt generator is suspended for
+ * the injection.
+ * Returns 1 if successful, 0 if the injection failed or NMI is asserted.
+ */
+uint8_t write_registers(const registers_t *registers)
+{
+    registers_t scratch = {.p = registers->p}; // Answer for the PLP pull
+    uint8_t generator;
+    uint16_t pc;
+
+    if (!suspend_generator(&generator))
+    {
+        return 0;
+    }
+
+    if (!next_fetch(&pc))
+    {
+        resume_generator(generator);
+        return 0;
+    }
+
+    const uint8_t stub[] = {
+        0xA2, registers->sp - 1,                // LDX #SP-1
+        0x9A,                                   // TXS
+        0xA9, registers->a,                     // LDA #A
+        0xA2, registers->x,                     // LDX #X
+        0xA0, registers->y,                     // LDY #Y
+        0x28,                                   // PLP, SP ends up at SP
+        0x4C, registers->pc & 0xFF, registers->pc >> 8, // JMP PC
+    };
+
+    uint8_t done = run_stub(pc, stub, sizeof(stub), &scratch);
+
+    resume_generator(generator);
+
+    if (!done)
+    {
+        return 0;
+    }
+
+    set_shadow(registers);
+    return 1;
+}
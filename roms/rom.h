@@ -5,7 +5,7 @@
   suggesting it performs graphics-related operations.
 */
 
-const uint8_t erom[] PROGMEM = {
+const uint8_t erom[] PROGMEM __attribute__((aligned(256))) = {
     0x4c, 0xb0, 0xe2, 0xad, 0x11, 0xd0, 0x10, 0xfb, 0xad, 0x10, 0xd0, 0x60,
     0x8a, 0x29, 0x20, 0xf0, 0x23, 0xa9, 0xa0, 0x85, 0xe4, 0x4c, 0xc9, 0xe3,
     0xa9, 0x20, 0xc5, 0x24, 0xb0, 0xc,  0xa9, 0x8d, 0xa0, 0x7,  0x20, 0xc9,
@@ -350,7 +350,7 @@ const uint8_t erom[] PROGMEM = {
     0x88, 0x4c, 0xc,  0xe0
 };
 
-const uint8_t from[] PROGMEM = {
+const uint8_t from[] PROGMEM __attribute__((aligned(256))) = {
     0xa9, 0x3,  0x85, 0xf8, 0xa9, 0x20, 0x85, 0xff, 0xa9, 0x7c, 0x85, 0xf9,
     0xa2, 0x1b, 0xbd, 0x67, 0xfd, 0x20, 0xef, 0xff, 0xca, 0xd0, 0xf7, 0xca,
     0x9a, 0x20, 0x71, 0xf0, 0xd8, 0xa9, 0x0,  0x85, 0x5b, 0x20, 0xce, 0xf0,
@@ -695,7 +695,7 @@ const uint8_t from[] PROGMEM = {
     0x0,  0xff, 0x14, 0xfe
 };
 
-const uint8_t rom[] PROGMEM = {
+const uint8_t rom[] PROGMEM __attribute__((aligned(256))) = {
     0xd8, 0x58, 0xa0, 0x7f, 0x8c, 0x12, 0xd0, 0xa9, 0xa7, 0x8d, 0x11, 0xd0,
     0x8d, 0x13, 0xd0, 0xc9, 0xdf, 0xf0, 0x13, 0xc9, 0x9b, 0xf0, 0x3,  0xc8,
     0x10, 0xf,  0xa9, 0xdc, 0x20, 0xef, 0xff, 0xa9, 0x8d, 0x20, 0xef, 0xff,
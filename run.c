@@ -0,0 +1,215 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Batched stepping engine. The CPU stays halted for the run-mode clock;
+ * continue_run() clocks it through the C bus service from the main loop.
+ */
+
+#include <avr/io.h>
+
+#include "pins.h"
+#include "breakpoint.h"
+#include "cpu.h"
+#include "memory.h"
+#include "run.h"
+
+#define MAX_WAIT        16 // PHI2 cycles to reach an opcode fetch
+
+// Global variables
+uint8_t run_state = RUN_IDLE;
+uint8_t run_seq;
+uint8_t run_reason;
+uint16_t run_pc;
+uint32_t run_count;
+static uint8_t run_mode;
+static uint16_t run_argument;
+static uint8_t run_depth;               // Call depth left to return from (RUN_OVER, RUN_OUT)
+
+/**
+ * Clock the CPU until the next cycle is an opcode fetch.
+ * Returns 1 if successful, 0 if no opcode fetch came up.
+ */
+static uint8_t reach_fetch(void)
+{
+    uint8_t wait = MAX_WAIT;
+
+    while (!(CONTROL_PIN & (1 << CPU_SYNC)))
+    {
+        if (!--wait)
+        {
+            return 0;
+        }
+        bus_cycle();
+    }
+
+    return 1;
+}
+
+/**
+ * Return the address on the bus, which at an instruction boundary is the
+ * PC of the next opcode fetch.
+ */
+static uint16_t bus_address(void)
+{
+    return ((uint16_t)ADDR_BUS_HIGH << 8) | ADDR_BUS_LOW;
+}
+
+/**
+ * Finish the run; the main loop sends the result.
+ */
+static void end_run(uint8_t reason)
+{
+    run_reason = reason;
+    run_state = RUN_DONE;
+}
+
+/**
+ * Halt the CPU at the next instruction boundary and start a run.
+ * Returns 1 if successful, 0 if the mode is invalid, a run is still in
+ * progress or the CPU does not reach an opcode fetch.
+ */
+uint8_t start_run(uint8_t mode, uint16_t argument, uint8_t seq)
+{
+    if (mode > RUN_OUT || run_state != RUN_IDLE)
+    {
+        return 0;
+    }
+
+    halt_cpu();
+
+    if (!reach_fetch())
+    {
+        return 0;
+    }
+
+    run_mode = mode;
+    run_argument = argument;
+    run_depth = mode == RUN_OUT ? 1 : 0;
+    run_count = 0;
+    run_pc = bus_address();
+    run_seq = seq;
+    run_state = RUN_ACTIVE;
+    return 1;
+}
+
+/**
+ * Check whether the run stops before the opcode fetch at pc.
+ */
+static uint8_t run_finished(uint16_t pc)
+{
+    if (run_count == 0)
+    {
+        return 0; // Always run at least one instruction
+    }
+
+    switch (run_mode)
+    {
+    case RUN_STEPS:
+        return run_count == (run_argument ? run_argument : 0x10000UL);
+    case RUN_UNTIL:
+        return pc == run_argument;
+    default:
+        return run_depth == 0;
+    }
+}
+
+/**
+ * Run up to RUN_BURST instructions, stopping at the first instruction
+ * boundary where the run is complete.
+ */
+void continue_run(void)
+{
+    uint8_t budget = RUN_BURST;
+
+    do
+    {
+        uint16_t pc = bus_address();
+        uint8_t opcode;
+
+        if (run_finished(pc))
+        {
+            end_run(STOP_DONE);
+            return;
+        }
+
+        if (!read_memory(pc, &opcode))
+        {
+            opcode = 0xEA; // Not code we can follow
+        }
+
+        bus_cycle(); // Opcode fetch
+
+        if (bus_address() == pc)
+        {
+            opcode = 0x00; // Interrupt: the fetch is discarded, count it as BRK
+        }
+
+        if (run_mode == RUN_OVER && run_count == 0 && opcode != 0x20 && opcode != 0x00)
+        {
+            run_argument = 1; // Nothing to step over: a single step
+            run_mode = RUN_STEPS;
+        }
+
+        switch (opcode)
+        {
+        case 0x00: // BRK
+        case 0x20: // JSR
+            run_depth++;
+            break;
+        case 0x40: // RTI
+        case 0x60: // RTS
+            run_depth--;
+            break;
+        }
+
+        run_pc = pc;
+        run_count++;
+
+        if (breakpoint_hit == HIT_BREAKPOINT && run_count == 1)
+        {
+            breakpoint_hit = 0; // Starting on a breakpoint does not stop the run
+        }
+
+        if (!breakpoint_hit && !reach_fetch())
+        {
+            end_run(STOP_HALTED); // CPU stopped fetching (WAI, STP)
+            return;
+        }
+
+        // Breakpoints stop at the fetch like in run mode, watchpoints after the access
+        if (breakpoint_hit)
+        {
+            end_run(STOP_HIT);
+            return;
+        }
+    } while (--budget);
+
+    run_pc = bus_address();
+}
+
+/**
+ * End a run in progress at the current instruction boundary.
+ */
+void cancel_run(void)
+{
+    if (run_state == RUN_ACTIVE)
+    {
+        run_pc = bus_address();
+        end_run(STOP_HALTED);
+    }
+}
+
+/**
+ * Fill in the RUN_RESULT-byte result and mark it sent.
+ */
+void run_result(uint8_t *result)
+{
+    result[0] = run_reason;
+    result[1] = run_pc >> 8;
+    result[2] = run_pc & 0xFF;
+    result[3] = run_count >> 24;
+    result[4] = run_count >> 16;
+    result[5] = run_count >> 8;
+    result[6] = run_count & 0xFF;
+    run_state = RUN_IDLE;
+}
@@ -4,6 +4,10 @@ import serial
 import threading
 import time
 from TimerRepeater import TimerRepeater
+from protocol import crc16
+
+# Size of the block shown by "Dump Page"
+DUMP_PAGE_SIZE = 256
 
 # Apply a dark theme to the interface
 def apply_dark_theme(root):
@@ -20,7 +24,7 @@ class SerialApp:
         """Initializes the GUI and serial communication."""
         self.root = root
         self.root.title("6502 Terminal")
-        self.root.geometry('640x480')
+        self.root.geometry('640x560')
         self.root.resizable(0, 0)
 
         # Apply a dark theme to the interface
@@ -32,6 +36,10 @@ class SerialApp:
         self.is_serial_connected = False
         self.auto_scroll = tk.BooleanVar(value=True)  # Variable to store checkbox state
 
+        # Page dump in progress (raw data followed by its CRC)
+        self.dump_address = None
+        self.dump_buffer = bytearray()
+
         # GUI components
         self.create_widgets()
 
@@ -92,6 +100,21 @@ class SerialApp:
         self.write_button = ttk.Button(memory_frame, text="Write Memory", command=self.write_memory, state='disabled')
         self.write_button.grid(row=0, column=5, padx=5, pady=5)
 
+        self.dump_button = ttk.Button(memory_frame, text="Dump Page", command=self.dump_page, state='disabled')
+        self.dump_button.grid(row=1, column=4, padx=5, pady=5)
+
+        # Frame for the Apple-1 terminal (PIA keyboard)
+        terminal_frame = ttk.Frame(self.root)
+        terminal_frame.pack(fill='x', padx=10)
+
+        ttk.Label(terminal_frame, text="Keys:").grid(row=0, column=0, padx=5, pady=5)
+        self.keys_entry = ttk.Entry(terminal_frame, width=50)
+        self.keys_entry.grid(row=0, column=1, padx=5, pady=5)
+        self.keys_entry.bind('<Return>', lambda event: self.send_keys())
+
+        self.keys_button = ttk.Button(terminal_frame, text="Send Keys", command=self.send_keys, state='disabled')
+        self.keys_button.grid(row=0, column=2, padx=5, pady=5)
+
         # Frame for auto-scroll option
         scroll_frame = ttk.Frame(self.root)
         scroll_frame.pack(pady=5)
@@ -132,6 +155,8 @@ class SerialApp:
         self.step_button.config(state=state)
         self.read_button.config(state=state)
         self.write_button.config(state=state)
+        self.dump_button.config(state=state)
+        self.keys_button.config(state=state)
 
     def log_message(self, message):
         """Logs a message to the console."""
@@ -194,6 +219,54 @@ class SerialApp:
         except ValueError:
             messagebox.showerror("Input Error", "Invalid address or data format.")
 
+    def send_keys(self):
+        """Types the entered text on the PIA keyboard, followed by Return."""
+        text = self.keys_entry.get()
+        keys = text.encode('ascii', errors='ignore') + b'\r'
+        self.send_command(b''.join(b'K' + bytes([key]) for key in keys))
+        self.keys_entry.delete(0, tk.END)
+        self.log_message(f"Sent: Keys {text}")
+
+    def dump_page(self):
+        """Dumps the 256-byte memory page holding the specified address."""
+        address = self.address_entry.get()
+        if not address:
+            messagebox.showwarning("Input Error", "Please enter an address.")
+            return
+
+        try:
+            page = int(address, 16) & 0xFF00
+            self.dump_address = page
+            self.dump_buffer = bytearray()
+            self.send_command(b'X' + page.to_bytes(2, 'big') + DUMP_PAGE_SIZE.to_bytes(2, 'big'))
+            self.log_message(f"Sent: Dump Page at 0x{page:04X}")
+        except (ValueError, OverflowError):
+            messagebox.showerror("Input Error", "Invalid address format.")
+
+    def receive_dump(self):
+        """Collects the raw bytes of a page dump and shows them once complete."""
+        self.dump_buffer += self.serial_port.read(DUMP_PAGE_SIZE + 2 - len(self.dump_buffer))
+
+        # The firmware answers an invalid range with a text error instead
+        if self.dump_buffer.startswith(b'Error') and b'\n' in self.dump_buffer:
+            message = self.dump_buffer.decode('utf-8', errors='ignore').strip()
+            self.log_message(f"Received: {message}")
+            self.dump_address = None
+            return
+
+        if len(self.dump_buffer) < DUMP_PAGE_SIZE + 2:
+            return
+
+        data = bytes(self.dump_buffer[:DUMP_PAGE_SIZE])
+        crc = int.from_bytes(self.dump_buffer[DUMP_PAGE_SIZE:], 'big')
+        if crc != crc16(data):
+            self.log_message(f"Error: Checksum mismatch in dump of 0x{self.dump_address:04X}")
+        else:
+            for offset in range(0, DUMP_PAGE_SIZE, 16):
+                row = ' '.join(f"{byte:02X}" for byte in data[offset:offset + 16])
+                self.log_message(f"{self.dump_address + offset:04X}: {row}")
+        self.dump_address = None
+
     def send_command(self, command):
         """Sends a command to the serial port."""
         if self.serial_port and self.serial_port.is_open:
@@ -205,6 +278,9 @@ class SerialApp:
         """Polls the serial port for incoming data."""
         if self.serial_port and self.serial_port.is_open:
             try:
+                if self.dump_address is not None:
+                    self.receive_dump()
+                    return
                 data = self.serial_port.readline()
                 if data:
                     message = data.decode('utf-8', errors='ignore').strip()
@@ -0,0 +1,176 @@
+import sys
+
+from protocol import FRAME_MAX_PAYLOAD, encode_frame
+
+# Token definitions (see include/unpack.h)
+UNPACK_FILL = 0x80
+UNPACK_COPY = 0xC0
+UNPACK_MIN_RUN = 3
+MAX_LITERAL = 128
+MAX_RUN = 0x3F + UNPACK_MIN_RUN
+MAX_DISTANCE = 0xFFFF
+
+# Shortest copy worth a 3-byte token, and how many candidates to try
+MIN_COPY = 4
+MAX_CHAIN = 64
+
+
+def _match(data, position, candidates):
+    """
+    Finds the longest earlier occurrence of the bytes at position.
+
+    Returns:
+        tuple: (length, distance) of the best match, (0, 0) if none.
+    """
+    best_length = best_distance = 0
+    limit = min(MAX_RUN, len(data) - position)
+
+    for candidate in reversed(candidates[-MAX_CHAIN:]):
+        distance = position - candidate
+        if distance > MAX_DISTANCE:
+            break
+        length = 0
+        while length < limit and data[candidate + length] == data[position + length]:
+            length += 1
+        if length > best_length:
+            best_length, best_distance = length, distance
+            if length == limit:
+                break
+
+    return best_length, best_distance
+
+
+def tokens(data, max_literal=MAX_LITERAL):
+    """
+    Compresses a memory image into tokens.
+
+    Parameters:
+        data (bytes): The image.
+        max_literal (int): Longest literal run per token (1-MAX_LITERAL).
+
+    Returns:
+        list: (encoded token, number of bytes it expands to) tuples.
+    """
+    data = bytes(data)
+    result = []
+    literal = bytearray()
+    chains = {}
+    position = 0
+
+    def flush_literal():
+        if literal:
+            result.append((bytes([len(literal) - 1]) + literal, len(literal)))
+            literal.clear()
+
+    while position < len(data):
+        # Runs of one byte value
+        run = 1
+        while run < MAX_RUN and position + run < len(data) and data[position + run] == data[position]:
+            run += 1
+
+        key = data[position:position + 3]
+        length, distance = _match(data, position, chains.get(key, [])) if len(key) == 3 else (0, 0)
+
+        if run >= UNPACK_MIN_RUN and run + 1 >= length:
+            flush_literal()
+            result.append((bytes([UNPACK_FILL | (run - UNPACK_MIN_RUN), data[position]]), run))
+            step = run
+        elif length >= MIN_COPY:
+            flush_literal()
+            result.append((bytes([UNPACK_COPY | (length - UNPACK_MIN_RUN), distance >> 8, distance & 0xFF]), length))
+            step = length
+        else:
+            literal.append(data[position])
+            if len(literal) == max_literal:
+                flush_literal()
+            step = 1
+
+        for index in range(position, position + step):
+            chains.setdefault(data[index:index + 3], []).append(index)
+        position += step
+
+    flush_literal()
+    return result
+
+
+def compress(data):
+    """
+    Compresses a memory image into a 'Z' stream.
+    """
+    return b''.join(token for token, _ in tokens(data))
+
+
+def decompress(stream):
+    """
+    Expands a 'Z' stream, as the firmware does (used to check the compressor).
+    """
+    output = bytearray()
+    position = 0
+
+    while position < len(stream):
+        control = stream[position]
+        if control < UNPACK_FILL:
+            output += stream[position + 1:position + 2 + control]
+            position += 2 + control
+        elif control < UNPACK_COPY:
+            output += bytes([stream[position + 1]]) * ((control & 0x3F) + UNPACK_MIN_RUN)
+            position += 2
+        else:
+            distance = (stream[position + 1] << 8) | stream[position + 2]
+            for _ in range((control & 0x3F) + UNPACK_MIN_RUN):
+                output.append(output[-distance])
+            position += 3
+
+    return bytes(output)
+
+
+def load_command(address, data):
+    """
+    Builds a legacy 'Z' command loading data at address.
+    """
+    stream = compress(data)
+    return b'Z' + address.to_bytes(2, 'big') + len(stream).to_bytes(2, 'big') + stream
+
+
+def load_frames(address, data, seq=1):
+    """
+    Builds framed 'Z' requests loading data at address. Frames end on
+    token boundaries, as the firmware restarts its decoder for each
+    frame, so literals are cut short enough to fit a frame after the
+    address. Copies read back from 6502 memory, so they may reach into
+    data loaded by earlier frames.
+
+    Returns:
+        list: The encoded frames, with consecutive sequence numbers from seq.
+    """
+    frames = []
+    payload = bytearray()
+    start = address
+
+    for token, size in tokens(data, FRAME_MAX_PAYLOAD - 3):
+        if payload and len(payload) + len(token) > FRAME_MAX_PAYLOAD - 2:
+            frames.append(encode_frame(seq, 'Z', start.to_bytes(2, 'big') + payload))
+            seq = seq % 255 + 1
+            start = address
+            payload.clear()
+        payload += token
+        address += size
+
+    if payload:
+        frames.append(encode_frame(seq, 'Z', start.to_bytes(2, 'big') + payload))
+
+    return frames
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        sys.exit("Usage: pack.py <image.bin> <output.z>")
+
+    with open(sys.argv[1], 'rb') as source:
+        image = source.read()
+    packed = compress(image)
+    assert decompress(packed) == image
+
+    with open(sys.argv[2], 'wb') as target:
+        target.write(packed)
+    print(f"{len(image)} -> {len(packed)} bytes ({len(image) / max(len(packed), 1):.1f}x)")
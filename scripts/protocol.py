@@ -0,0 +1,288 @@
+import binascii
+
+# Frame definitions (see include/protocol.h)
+FRAME_SOF = 0xA5
+FRAME_MAX_PAYLOAD = 128
+
+# Page hashes returned by 'Q'
+PAGE_SIZE = 256
+
+# Capture sample flags and trigger qualifiers ('V' and 'Y')
+CAPTURE_READ = 0x01
+CAPTURE_WRITE = 0x02
+CAPTURE_SYNC = 0x04
+
+# Profiler modes ('p')
+PROFILE_STOP = 0
+PROFILE_INSTRUCTIONS = 1
+PROFILE_CYCLES = 2
+PROFILE_READ = 3
+
+# Apple-1 clock preset for 'F' (14.31818 MHz / 14), clamped to the fastest rate of the build
+CLOCK_APPLE1_HZ = 1022727
+
+# Interrupt generator lines and modes ('i'), status register at $D100
+LINE_IRQ = 0
+LINE_NMI = 1
+GEN_OFF = 0
+GEN_ONCE = 1
+GEN_PERIODIC = 2
+GEN_ADDRESS = 3
+IRQ_STATUS = 0xD100
+
+# Batched step modes and stop reasons ('s')
+RUN_STEPS = 0
+RUN_UNTIL = 1
+RUN_OVER = 2
+RUN_OUT = 3
+STOP_DONE = 0
+STOP_HIT = 1
+STOP_HALTED = 2
+
+# Performance counters returned by 'I', in order (see include/stats.h)
+STATS_COUNTERS = ('cycles', 'instructions', 'reads', 'writes', 'irqs', 'nmis', 'hits', 'unmapped')
+STAT_UNAVAILABLE = 0xFFFFFFFF
+
+# Protocol modes
+PROTOCOL_LEGACY = 0
+PROTOCOL_FRAMED = 1
+
+# Response status codes
+STATUS_OK = 0x00
+STATUS_BAD_CRC = 0x01
+STATUS_UNKNOWN_COMMAND = 0x02
+STATUS_BAD_LENGTH = 0x03
+STATUS_INVALID_ADDRESS = 0x04
+STATUS_INVALID_ARGUMENT = 0x05
+STATUS_FULL = 0x06
+STATUS_NOT_FOUND = 0x07
+STATUS_UNSUPPORTED = 0x08
+STATUS_MORE = 0x09
+STATUS_BUSY = 0x0A
+STATUS_EVENT = 0x80
+
+
+def crc16(data):
+    """
+    Computes the CRC-16/XMODEM used by the frames.
+    """
+    return binascii.crc_hqx(bytes(data), 0)
+
+
+def changed_pages(image, first_page, hashes):
+    """
+    Compares a local image with the page hashes returned by 'Q'.
+
+    Parameters:
+        image (bytes): Image to be loaded at page first_page.
+        first_page (int): Page the image starts at.
+        hashes (bytes): 'Q' response for the pages covered by the image.
+
+    Returns:
+        list: Numbers of the pages that must be uploaded again. A partial
+        last page is always included, as its tail is not part of the image.
+    """
+    changed = []
+
+    for index in range(0, len(image), PAGE_SIZE):
+        page = image[index:index + PAGE_SIZE]
+        number = index // PAGE_SIZE
+        remote = int.from_bytes(hashes[number * 2:number * 2 + 2], 'big')
+        if len(page) < PAGE_SIZE or crc16(page) != remote:
+            changed.append(first_page + number)
+
+    return changed
+
+
+def parse_registers(data):
+    """
+    Decodes a 'G' response payload.
+
+    Parameters:
+        data (bytes): The 7-byte payload.
+
+    Returns:
+        dict: The values of 'a', 'x', 'y', 'sp', 'p' and 'pc'.
+    """
+    return {
+        'a': data[0],
+        'x': data[1],
+        'y': data[2],
+        'sp': data[3],
+        'p': data[4],
+        'pc': int.from_bytes(data[5:7], 'big'),
+    }
+
+
+def parse_trace(data):
+    """
+    Decodes a 'T' trace download.
+
+    Parameters:
+        data (bytes): The downloaded block, without the trailing CRC.
+
+    Returns:
+        list: (pc, opcode, cycle) tuples, oldest first. The 16-bit
+        timestamps are extended to full cycle numbers going back from
+        the cycle counter sent in the header.
+    """
+    count = data[0]
+    cycle = int.from_bytes(data[1:5], 'big')
+    pcs = data[5:5 + 2 * count]
+    opcodes = data[5 + 2 * count:5 + 3 * count]
+    times = data[5 + 3 * count:5 + 5 * count]
+
+    entries = []
+    for index in reversed(range(count)):
+        time = int.from_bytes(times[2 * index:2 * index + 2], 'big')
+        cycle -= (cycle - time) & 0xFFFF
+        pc = int.from_bytes(pcs[2 * index:2 * index + 2], 'big')
+        entries.append((pc, opcodes[index], cycle))
+
+    entries.reverse()
+    return entries
+
+
+def parse_capture(data):
+    """
+    Decodes a 'Y' capture download.
+
+    Parameters:
+        data (bytes): The downloaded block, without the trailing CRC.
+
+    Returns:
+        tuple: (trigger index, list of (address, data, flags) samples, oldest first).
+    """
+    count = int.from_bytes(data[0:2], 'big')
+    trigger = int.from_bytes(data[2:4], 'big')
+    addresses = data[4:4 + 2 * count]
+    values = data[4 + 2 * count:4 + 3 * count]
+    flags = data[4 + 3 * count:4 + 4 * count]
+
+    samples = [(int.from_bytes(addresses[2 * index:2 * index + 2], 'big'), values[index], flags[index])
+               for index in range(count)]
+    return trigger, samples
+
+
+def parse_stats(data):
+    """
+    Decodes an 'I' response payload.
+
+    Parameters:
+        data (bytes): The counters, 4 bytes big-endian each.
+
+    Returns:
+        dict: Counter values by name, None for counters the firmware could
+        not keep (cycles served by the assembly bus loop). Two readings
+        taken a known time apart give the effective PHI2 rate from the
+        'cycles' difference.
+    """
+    counters = {}
+
+    for index, name in enumerate(STATS_COUNTERS):
+        value = int.from_bytes(data[4 * index:4 * index + 4], 'big')
+        counters[name] = None if value == STAT_UNAVAILABLE else value
+
+    return counters
+
+
+def parse_profile(data):
+    """
+    Decodes a 'p' profile download.
+
+    Parameters:
+        data (bytes): The downloaded block, without the trailing CRC.
+
+    Returns:
+        tuple: (base address, bucket size, total samples, list of bucket counts).
+    """
+    base = int.from_bytes(data[0:2], 'big')
+    size = 1 << data[2]
+    samples = int.from_bytes(data[4:8], 'big')
+    counts = [int.from_bytes(data[index:index + 2], 'big') for index in range(8, len(data), 2)]
+    return base, size, samples, counts
+
+
+def hot_spots(profile, top=10):
+    """
+    Ranks the buckets of a profile by sample count.
+
+    Parameters:
+        profile (tuple): The result of parse_profile().
+        top (int): Number of buckets to return.
+
+    Returns:
+        list: (first address, last address, samples, share of all samples)
+        tuples, hottest first. Buckets past $FFFF are left out.
+    """
+    base, size, samples, counts = profile
+    ranked = sorted((count, index) for index, count in enumerate(counts)
+                    if count and base + index * size <= 0xFFFF)
+    ranked.reverse()
+    return [(base + index * size, min(base + (index + 1) * size - 1, 0xFFFF), count,
+             count / samples if samples else 0.0)
+            for count, index in ranked[:top]]
+
+
+def encode_frame(seq, command, payload=b''):
+    """
+    Builds a request frame.
+
+    Parameters:
+        seq (int): Sequence number echoed in the response (1-255, 0 is used for events).
+        command (str or int): Command letter or byte.
+        payload (bytes): Command payload, at most FRAME_MAX_PAYLOAD bytes.
+
+    Returns:
+        bytes: The encoded frame.
+    """
+    if isinstance(command, str):
+        command = ord(command)
+    body = bytes([len(payload), seq & 0xFF, command]) + bytes(payload)
+    return bytes([FRAME_SOF]) + body + crc16(body).to_bytes(2, 'big')
+
+
+class FrameReader:
+    """
+    Incremental parser for response and event frames.
+    """
+
+    def __init__(self):
+        """
+        Creates an empty parser.
+        """
+        self._buffer = bytearray()
+
+    def feed(self, data):
+        """
+        Adds received bytes and returns the complete frames found.
+
+        Returns:
+            list: (seq, status, payload) tuples. Frames with a bad CRC are dropped.
+        """
+        self._buffer += data
+        frames = []
+
+        while True:
+            start = self._buffer.find(FRAME_SOF)
+            if start < 0:
+                self._buffer.clear()
+                break
+            del self._buffer[:start]
+
+            if len(self._buffer) < 4:
+                break
+            length = self._buffer[1]
+            total = 4 + length + 2
+            if len(self._buffer) < total:
+                break
+
+            body = bytes(self._buffer[1:4 + length])
+            crc = int.from_bytes(self._buffer[4 + length:total], 'big')
+            if crc == crc16(body):
+                frames.append((body[1], body[2], body[3:]))
+                del self._buffer[:total]
+            else:
+                del self._buffer[:1]  # Resynchronize on the next SOF
+
+        return frames
@@ -0,0 +1,97 @@
+import os
+import random
+import sys
+import unittest
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+from pack import UNPACK_COPY, UNPACK_FILL, UNPACK_MIN_RUN, compress, decompress, load_frames
+from protocol import FRAME_MAX_PAYLOAD, crc16
+
+
+def _frames(frames):
+    """
+    Splits encoded 'Z' frames into (length, address, token stream) tuples,
+    checking the header and CRC of each.
+    """
+    result = []
+    for frame in frames:
+        length = frame[1]
+        body = frame[1:4 + length]
+        assert frame[3] == ord('Z')
+        assert crc16(body) == int.from_bytes(frame[4 + length:], 'big')
+        payload = frame[4:4 + length]
+        result.append((length, int.from_bytes(payload[:2], 'big'), payload[2:]))
+    return result
+
+
+def _unpack(memory, address, stream):
+    """
+    Decodes a 'Z' token stream into memory at address, as unpack.c does:
+    copies read back from memory, so they may reach into data written by
+    earlier frames.
+    """
+    position = 0
+
+    while position < len(stream):
+        control = stream[position]
+        if control < UNPACK_FILL:
+            count = control + 1
+            memory[address:address + count] = stream[position + 1:position + 1 + count]
+            position += 1 + count
+        elif control < UNPACK_COPY:
+            count = (control & 0x3F) + UNPACK_MIN_RUN
+            memory[address:address + count] = bytes([stream[position + 1]]) * count
+            position += 2
+        else:
+            count = (control & 0x3F) + UNPACK_MIN_RUN
+            distance = (stream[position + 1] << 8) | stream[position + 2]
+            assert 0 < distance <= address
+            for offset in range(count):
+                memory[address + offset] = memory[address + offset - distance]
+            position += 3
+        address += count
+
+
+class LoadFramesTest(unittest.TestCase):
+    def check_image(self, image, address=0x0280):
+        memory = bytearray(0x10000)
+        frames = _frames(load_frames(address, image))
+
+        for length, start, stream in frames:
+            # The firmware rejects anything outside 3..FRAME_MAX_PAYLOAD
+            self.assertGreaterEqual(length, 3)
+            self.assertLessEqual(length, FRAME_MAX_PAYLOAD)
+            _unpack(memory, start, stream)
+
+        self.assertEqual(bytes(memory[address:address + len(image)]), image)
+
+    def test_random_data(self):
+        generator = random.Random(6502)
+        for size in (1, 125, 126, 127, 128, 129, 300, 4096):
+            self.check_image(bytes(generator.randrange(256) for _ in range(size)))
+
+    def test_mixed_data(self):
+        generator = random.Random(65)
+        image = bytearray()
+        while len(image) < 8192:
+            if generator.randrange(2):
+                image += bytes([generator.randrange(256)]) * generator.randrange(1, 200)
+            else:
+                image += bytes(generator.randrange(256) for _ in range(generator.randrange(1, 300)))
+        self.check_image(bytes(image))
+
+    def test_repeated_block(self):
+        # Copies of the block reach back into frames sent earlier
+        generator = random.Random(200)
+        block = bytes(generator.randrange(256) for _ in range(200))
+        self.check_image(block * 4)
+
+    def test_legacy_stream(self):
+        generator = random.Random(2)
+        image = bytes(generator.randrange(4) for _ in range(4096))
+        self.assertEqual(decompress(compress(image)), image)
+
+
+if __name__ == '__main__':
+    unittest.main()
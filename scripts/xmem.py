@@ -0,0 +1,153 @@
+import os
+import re
+import shlex
+import subprocess
+import sys
+
+# Host-side model of the XMEM build profiles (make XMEM=32 / XMEM=64):
+# how 6502 addresses reach the external SRAM chip through the page table
+# and the AVR external memory interface. MEMORY_SIZE and MEMORY_BASE are
+# taken from include/memory.h by the firmware's own C preprocessor, so the
+# checks follow it. Run it directly to check both profiles.
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+
+# Compiler of the firmware build, used for its preprocessor only
+CC = os.environ.get('CC', 'avr-gcc')
+
+# ATmega2560 data space: internal SRAM ends at 0x21FF, above it the
+# external memory interface drives the address onto PORTA/PORTC
+INTERNAL_SRAM_END = 0x2200
+
+# XMCRA/XMCRB settings written by init_memory_map()
+SRE = 0x80
+XMM0 = 0x01
+XMCRA = SRE
+XMCRB = {64: 0x00, 32: XMM0}
+CHIP_SIZE = {64: 0x10000, 32: 0x8000}
+
+# Page types (see include/memory.h)
+PAGE_UNMAPPED = 'unmapped'
+PAGE_RAM = 'ram'
+
+
+def memory_layout(kb):
+    """
+    Expands MEMORY_SIZE and MEMORY_BASE of a profile with the C
+    preprocessor, as the firmware build does.
+
+    Returns:
+        tuple: (size, base) in bytes and AVR data address.
+    """
+    include = os.path.join(ROOT, 'include')
+    command = shlex.split(CC) + ['-E', '-dM', '-DXMEM_SIZE_KB=%d' % kb, '-I', include,
+                                 os.path.join(include, 'memory.h')]
+    if 'avr' in os.path.basename(command[0]):
+        command.insert(1, '-mmcu=atmega2560')
+    output = subprocess.run(command, check=True, capture_output=True, text=True).stdout
+    defines = dict(re.findall(r'#define (\w+) (.*)', output))
+    size = int(defines['MEMORY_SIZE'], 0)
+    base = int(re.search(r'0x[0-9A-Fa-f]+', defines['MEMORY_BASE']).group(0), 16)
+    return size, base
+
+
+def chip_address(kb, avr):
+    """
+    Follows an AVR data address through the external memory interface.
+
+    Returns:
+        int: The address seen by the SRAM chip, None for internal SRAM.
+    """
+    if avr < INTERNAL_SRAM_END:
+        return None
+    released = XMCRB[kb] & 0x07  # XMM: high address pins handed back to PORTC
+    return (avr & (0xFFFF >> released)) % CHIP_SIZE[kb]
+
+
+def page_table(kb):
+    """
+    Builds the RAM part of the page table as init_memory_map() does.
+
+    Returns:
+        list: 256 (type, base) tuples; base is the AVR address of offset 0
+        for RAM pages, None for every other page.
+    """
+    size, base = memory_layout(kb)
+    table = [(PAGE_UNMAPPED, None)] * 256
+
+    for page in range(size // 256):
+        table[page] = (PAGE_RAM, base + page * 256)
+
+    return table
+
+
+def translate(kb, table, address):
+    """
+    Decodes a 6502 address as bus_read() does.
+
+    Returns:
+        tuple: (page type, chip address for RAM, else None).
+    """
+    address &= 0xFFFF
+    kind, base = table[address >> 8]
+    if kind != PAGE_RAM:
+        return kind, None
+    return kind, chip_address(kb, base + (address & 0xFF))
+
+
+def check(kb):
+    """
+    Checks one profile (kb is 32 or 64).
+
+    Returns:
+        list: Failure messages, empty if the profile is consistent.
+    """
+    failures = []
+
+    def expect(condition, message):
+        if not condition:
+            failures.append('XMEM=%d: %s' % (kb, message))
+
+    size, base = memory_layout(kb)
+    table = page_table(kb)
+    ram = [address for address in range(0x10000) if table[address >> 8][0] == PAGE_RAM]
+
+    # Backing store
+    expect(XMCRA & SRE, 'external memory interface disabled')
+    expect(base % 256 == 0, 'MEMORY_BASE not page aligned for bus.S')
+    expect(base >= INTERNAL_SRAM_END, 'MEMORY_BASE inside internal SRAM')
+    expect(base + size <= 0x10000, 'backing store wraps past AVR 0xFFFF')
+    expect(len(ram) == size, 'page table maps %d RAM bytes, MEMORY_SIZE is %d' % (len(ram), size))
+
+    # Every RAM byte reaches its own chip byte
+    chip = [translate(kb, table, address)[1] for address in ram]
+    expect(None not in chip, 'RAM address shadowed by internal SRAM')
+    expect(len(set(chip)) == len(chip), 'two RAM addresses alias one chip byte')
+    expect(all(address is None or address < CHIP_SIZE[kb] for address in chip), 'chip address out of range')
+
+    # Boundaries
+    expect(translate(kb, table, 0x0000) == (PAGE_RAM, chip_address(kb, base)), '$0000 not at MEMORY_BASE')
+    expect(translate(kb, table, size - 1) == (PAGE_RAM, chip_address(kb, base + size - 1)), 'last RAM byte misplaced')
+    expect(translate(kb, table, size)[0] != PAGE_RAM, 'RAM runs past MEMORY_SIZE')
+    if kb == 64:
+        expect(chip_address(kb, base + size - 1) == 0xF1FF, '$CFFF not at chip 0xF1FF')
+    else:
+        expect(chip_address(kb, base + size - 1) == 0x7FFF, '$7FFF not at chip 0x7FFF')
+        expect(sorted(chip) == list(range(CHIP_SIZE[kb])), 'RAM does not cover the 32 KB chip')
+
+    # 6502 addresses wrap at 64 KB, onto RAM at $0000
+    expect(translate(kb, table, 0x10000) == translate(kb, table, 0x0000), '$10000 does not wrap to $0000')
+
+    return failures
+
+
+if __name__ == '__main__':
+    failures = []
+    for kb in (32, 64):
+        failures += check(kb)
+
+    for failure in failures:
+        print(failure)
+    if failures:
+        sys.exit(1)
+    print("XMEM model: 32 KB and 64 KB profiles consistent")
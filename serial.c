@@ -0,0 +1,317 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * USART0 RX/TX interrupt handlers and ring buffers.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+
+#include "serial.h"
+
+#ifdef BUS_LOOP_ASM
+#include "bus.h"
+#endif
+
+#define RX_MASK (SERIAL_RX_SIZE - 1)
+#define TX_MASK (SERIAL_TX_SIZE - 1)
+
+// Ring buffers: head is written by the producer, tail by the consumer
+static volatile uint8_t rx_buffer[SERIAL_RX_SIZE];
+static volatile uint8_t rx_head = 0;
+static volatile uint8_t rx_tail = 0;
+static volatile uint8_t tx_buffer[SERIAL_TX_SIZE];
+static volatile uint8_t tx_head = 0;
+static volatile uint8_t tx_tail = 0;
+
+// Baud rate negotiation
+static uint32_t current_baud_rate;              // Rate in use
+static uint32_t previous_baud_rate;             // Rate to fall back to
+static volatile uint16_t confirm_timeout = 0;   // ms left to hear from the host
+
+#ifdef BUS_LOOP_ASM
+static volatile uint8_t burst_per_byte;         // bus.S cycles per received byte, halved
+#endif
+
+/**
+ * Calculate the UBRR value for double-speed (U2X) mode, rounded to nearest.
+ */
+static uint16_t ubrr_for(uint32_t baud_rate)
+{
+    return (F_CPU + 4UL * baud_rate) / (8UL * baud_rate) - 1;
+}
+
+/**
+ * Program the baud rate generator.
+ */
+static void set_baud_rate(uint32_t baud_rate)
+{
+    uint16_t ubrr_value = ubrr_for(baud_rate);
+
+    // Set baud rate
+    UBRR0H = (uint8_t)(ubrr_value >> 8);
+    UBRR0L = (uint8_t)(ubrr_value & 0xFF);
+    current_baud_rate = baud_rate;
+
+#ifdef BUS_LOOP_ASM
+    // 10 bits per byte, timed at the slower ROM read rate
+    uint32_t per_byte = F_CPU * 10 / baud_rate / (2 * BUS_ASM_ROM_CYCLES);
+
+    burst_per_byte = per_byte > 255 ? 255 : per_byte;
+#endif
+}
+
+/**
+ * Initialize serial communication (UART) with configurable baud rate.
+ * Double-speed mode (U2X) divides by 8 instead of 16, which makes 500k,
+ * 1M and 2M baud exact at 16 MHz and halves the error at lower rates.
+ */
+void init_serial(uint32_t baud_rate)
+{
+    UCSR0A = (1 << U2X0);
+    set_baud_rate(baud_rate);
+
+    // Enable receiver, transmitter and the receive interrupt
+    UCSR0B = (1 << RXEN0) | (1 << TXEN0) | (1 << RXCIE0);
+
+    // Set frame format: 8 data bits, no parity, 1 stop bit
+    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
+}
+
+/**
+ * USART0 receive complete: queue the byte, dropping it if the buffer is full.
+ */
+ISR(USART0_RX_vect)
+{
+    uint8_t framing_error = UCSR0A & (1 << FE0);
+    uint8_t data = UDR0;
+    uint8_t next = (rx_head + 1) & RX_MASK;
+
+    // A baud rate switch is confirmed by BAUD_CONFIRM_BYTE, received
+    // cleanly at the new rate. Anything before it is noise from the
+    // switch, and is dropped along with the confirmation itself.
+    if (confirm_timeout)
+    {
+        if (data == BAUD_CONFIRM_BYTE && !framing_error)
+        {
+            confirm_timeout = 0;
+            TCCR0B = 0x00;
+        }
+
+        return;
+    }
+
+    if (next != rx_tail)
+    {
+        rx_buffer[rx_head] = data;
+        rx_head = next;
+    }
+}
+
+/**
+ * USART0 data register empty: send the next queued byte.
+ */
+ISR(USART0_UDRE_vect)
+{
+    if (tx_head != tx_tail)
+    {
+        UDR0 = tx_buffer[tx_tail];
+        tx_tail = (tx_tail + 1) & TX_MASK;
+
+        // Clear TXC0 so it only sets once this byte has left the shifter
+        UCSR0A = (UCSR0A & (1 << U2X0)) | (1 << TXC0);
+    }
+    else
+    {
+        UCSR0B &= ~(1 << UDRIE0); // Nothing left to send
+    }
+}
+
+/**
+ * Timer0 compare match (1 ms), running only while a baud rate switch is
+ * unconfirmed: fall back to the previous rate when the window expires.
+ */
+ISR(TIMER0_COMPA_vect)
+{
+    if (confirm_timeout && !--confirm_timeout)
+    {
+        TCCR0B = 0x00;
+        set_baud_rate(previous_baud_rate);
+    }
+}
+
+/**
+ * Check whether a baud rate can be generated within BAUD_MAX_ERROR percent.
+ * Returns 1 if supported, 0 otherwise.
+ */
+uint8_t baud_rate_supported(uint32_t baud_rate)
+{
+    if (baud_rate == 0 || baud_rate > F_CPU / 8)
+    {
+        return 0;
+    }
+
+    uint16_t ubrr_value = ubrr_for(baud_rate);
+
+    if (ubrr_value > 0x0FFF)
+    {
+        return 0; // UBRR0 is 12 bits wide
+    }
+
+    uint32_t actual = F_CPU / (8UL * (ubrr_value + 1));
+    uint32_t error = actual > baud_rate ? actual - baud_rate : baud_rate - actual;
+
+    return error * 100 <= baud_rate * BAUD_MAX_ERROR;
+}
+
+/**
+ * Switch to a new baud rate once all queued output has been sent.
+ * The host must send BAUD_CONFIRM_BYTE at the new rate within
+ * BAUD_CONFIRM_MS, otherwise the link falls back to the previous rate.
+ */
+void switch_baud_rate(uint32_t baud_rate)
+{
+    // Wait until the reply at the old rate has fully left the shifter
+    while (tx_head != tx_tail || !(UCSR0A & (1 << TXC0)))
+        ;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        previous_baud_rate = current_baud_rate;
+        set_baud_rate(baud_rate);
+
+        // Start the confirmation window on Timer0 (CTC, 1 ms per match)
+        confirm_timeout = BAUD_CONFIRM_MS;
+        TCCR0A = (1 << WGM01);
+        OCR0A = F_CPU / 64 / 1000 - 1;
+        TCNT0 = 0;
+        TIMSK0 = (1 << OCIE0A);
+        TCCR0B = (1 << CS01) | (1 << CS00); // Prescaler 64
+    }
+}
+
+/**
+ * Return the number of received bytes waiting in the buffer.
+ */
+uint8_t serial_available(void)
+{
+    return (rx_head - rx_tail) & RX_MASK;
+}
+
+/**
+ * Return the next received byte without removing it.
+ * Only valid when serial_available() is non-zero.
+ */
+uint8_t serial_peek(void)
+{
+    return rx_buffer[rx_tail];
+}
+
+/**
+ * Return the number of bytes that can be queued without waiting.
+ */
+uint8_t serial_tx_free(void)
+{
+    return TX_MASK - ((tx_head - tx_tail) & TX_MASK);
+}
+
+#ifdef BUS_LOOP_ASM
+/**
+ * Return the longest bus.S burst (1 to 255 cycles) during which the
+ * host cannot fill more than half of the room left in the receive
+ * buffer, which is only drained between bursts. The other half covers
+ * the time the receive interrupt itself adds to the burst.
+ */
+uint8_t serial_burst_limit(void)
+{
+    uint16_t limit = (uint16_t)(RX_MASK - serial_available()) * burst_per_byte;
+
+    if (limit > 255)
+    {
+        return 255;
+    }
+
+    return limit ? limit : 1;
+}
+#endif
+
+/**
+ * Receive a byte from the serial port.
+ * Waits if the buffer is empty; callers check serial_available() first.
+ */
+uint8_t receive_byte(void)
+{
+    // Wait for data to be received
+    while (rx_head == rx_tail)
+        ;
+
+    uint8_t data = rx_buffer[rx_tail];
+    rx_tail = (rx_tail + 1) & RX_MASK;
+    return data;
+}
+
+/**
+ * Send a byte via the serial port.
+ * Only waits if the transmit buffer is full.
+ */
+void send_byte(uint8_t data)
+{
+    uint8_t next = (tx_head + 1) & TX_MASK;
+
+    // Wait for room in the transmit buffer
+    while (next == tx_tail)
+        ;
+
+    tx_buffer[tx_head] = data;
+    tx_head = next;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        UCSR0B |= (1 << UDRIE0); // Start or keep the transmitter running
+    }
+}
+
+/**
+ * Send a byte in hexadecimal format via the serial port.
+ */
+void send_byte_hex(uint8_t data)
+{
+    static const char hex_digits[] PROGMEM = "0123456789ABCDEF";
+    send_byte(pgm_read_byte(&hex_digits[(data >> 4) & 0x0F]));
+    send_byte(pgm_read_byte(&hex_digits[data & 0x0F]));
+}
+
+/**
+ * Send a string kept in flash (PSTR() or PROGMEM) via the serial port.
+ */
+void send_string_P(const char *str)
+{
+    char c;
+
+    while ((c = pgm_read_byte(str++)))
+    {
+        send_byte(c);
+    }
+}
+
+/**
+ * Send an unsigned value in decimal format via the serial port.
+ */
+void send_decimal(uint32_t value)
+{
+    char digits[10];
+    uint8_t count = 0;
+
+    do
+    {
+        digits[count++] = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+
+    while (count)
+    {
+        send_byte(digits[--count]);
+    }
+}
@@ -0,0 +1,334 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Shadow register tracking: the opcode class table and the per-instruction
+ * update.
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+
+#include "pins.h"
+#include "cpu.h"
+#include "shadow.h"
+
+// P bits
+#define FLAG_N          0x80
+#define FLAG_Z          0x02
+#define FLAG_PUSHED     0x30 // B and the unused bit, set as PHP pushes them
+
+// Global variables
+volatile uint8_t shadow_enabled = 0;
+registers_t shadow;
+uint8_t shadow_valid = 0;
+uint8_t shadow_opcode;
+uint8_t shadow_class = SH_NONE;
+uint8_t shadow_cycle;
+uint16_t shadow_fetch;
+uint8_t shadow_read;
+uint8_t shadow_write;
+uint8_t shadow_stack;
+
+// Class of every 65C02 opcode (Rockwell bit instructions included as SH_NONE)
+const uint8_t shadow_classes[256] PROGMEM = {
+    SH_INTERRUPT, SH_ALU_A, SH_NONE, SH_NONE, SH_FLAGS, SH_ALU_A, SH_FLAGS, SH_NONE,  // 00
+    SH_PUSH_P, SH_ALU_A, SH_ALU_A, SH_NONE, SH_FLAGS, SH_ALU_A, SH_FLAGS, SH_NONE,  // 08
+    SH_NONE, SH_ALU_A, SH_ALU_A, SH_NONE, SH_FLAGS, SH_ALU_A, SH_FLAGS, SH_NONE,  // 10
+    SH_FLAG, SH_ALU_A, SH_ALU_A, SH_NONE, SH_FLAGS, SH_ALU_A, SH_FLAGS, SH_NONE,  // 18
+    SH_STACK, SH_ALU_A, SH_NONE, SH_NONE, SH_FLAGS, SH_ALU_A, SH_FLAGS, SH_NONE,  // 20
+    SH_PULL_P, SH_ALU_A, SH_ALU_A, SH_NONE, SH_FLAGS, SH_ALU_A, SH_FLAGS, SH_NONE,  // 28
+    SH_NONE, SH_ALU_A, SH_ALU_A, SH_NONE, SH_FLAGS, SH_ALU_A, SH_FLAGS, SH_NONE,  // 30
+    SH_FLAG, SH_ALU_A, SH_ALU_A, SH_NONE, SH_FLAGS, SH_ALU_A, SH_FLAGS, SH_NONE,  // 38
+    SH_RTI, SH_ALU_A, SH_NONE, SH_NONE, SH_NONE, SH_ALU_A, SH_FLAGS, SH_NONE,  // 40
+    SH_PUSH_A, SH_ALU_A, SH_ALU_A, SH_NONE, SH_NONE, SH_ALU_A, SH_FLAGS, SH_NONE,  // 48
+    SH_NONE, SH_ALU_A, SH_ALU_A, SH_NONE, SH_NONE, SH_ALU_A, SH_FLAGS, SH_NONE,  // 50
+    SH_FLAG, SH_ALU_A, SH_PUSH_Y, SH_NONE, SH_NONE, SH_ALU_A, SH_FLAGS, SH_NONE,  // 58
+    SH_STACK, SH_ALU_A, SH_NONE, SH_NONE, SH_NONE, SH_ALU_A, SH_FLAGS, SH_NONE,  // 60
+    SH_PULL_A, SH_ALU_A, SH_ALU_A, SH_NONE, SH_NONE, SH_ALU_A, SH_FLAGS, SH_NONE,  // 68
+    SH_NONE, SH_ALU_A, SH_ALU_A, SH_NONE, SH_NONE, SH_ALU_A, SH_FLAGS, SH_NONE,  // 70
+    SH_FLAG, SH_ALU_A, SH_PULL_Y, SH_NONE, SH_NONE, SH_ALU_A, SH_FLAGS, SH_NONE,  // 78
+    SH_NONE, SH_STORE_A, SH_NONE, SH_NONE, SH_STORE_Y, SH_STORE_A, SH_STORE_X, SH_NONE,  // 80
+    SH_DEY, SH_FLAGS, SH_TXA, SH_NONE, SH_STORE_Y, SH_STORE_A, SH_STORE_X, SH_NONE,  // 88
+    SH_NONE, SH_STORE_A, SH_STORE_A, SH_NONE, SH_STORE_Y, SH_STORE_A, SH_STORE_X, SH_NONE,  // 90
+    SH_TYA, SH_STORE_A, SH_TXS, SH_NONE, SH_NONE, SH_STORE_A, SH_NONE, SH_NONE,  // 98
+    SH_LOAD_Y, SH_LOAD_A, SH_LOAD_X, SH_NONE, SH_LOAD_Y, SH_LOAD_A, SH_LOAD_X, SH_NONE,  // A0
+    SH_TAY, SH_LOAD_A, SH_TAX, SH_NONE, SH_LOAD_Y, SH_LOAD_A, SH_LOAD_X, SH_NONE,  // A8
+    SH_NONE, SH_LOAD_A, SH_LOAD_A, SH_NONE, SH_LOAD_Y, SH_LOAD_A, SH_LOAD_X, SH_NONE,  // B0
+    SH_FLAG, SH_LOAD_A, SH_TSX, SH_NONE, SH_LOAD_Y, SH_LOAD_A, SH_LOAD_X, SH_NONE,  // B8
+    SH_FLAGS, SH_FLAGS, SH_NONE, SH_NONE, SH_FLAGS, SH_FLAGS, SH_FLAGS, SH_NONE,  // C0
+    SH_INY, SH_FLAGS, SH_DEX, SH_NONE, SH_FLAGS, SH_FLAGS, SH_FLAGS, SH_NONE,  // C8
+    SH_NONE, SH_FLAGS, SH_FLAGS, SH_NONE, SH_NONE, SH_FLAGS, SH_FLAGS, SH_NONE,  // D0
+    SH_FLAG, SH_FLAGS, SH_PUSH_X, SH_NONE, SH_NONE, SH_FLAGS, SH_FLAGS, SH_NONE,  // D8
+    SH_FLAGS, SH_ALU_A, SH_NONE, SH_NONE, SH_FLAGS, SH_ALU_A, SH_FLAGS, SH_NONE,  // E0
+    SH_INX, SH_ALU_A, SH_NONE, SH_NONE, SH_FLAGS, SH_ALU_A, SH_FLAGS, SH_NONE,  // E8
+    SH_NONE, SH_ALU_A, SH_ALU_A, SH_NONE, SH_NONE, SH_ALU_A, SH_FLAGS, SH_NONE,  // F0
+    SH_FLAG, SH_ALU_A, SH_PULL_X, SH_NONE, SH_NONE, SH_ALU_A, SH_FLAGS, SH_NONE,  // F8
+};
+
+// Flag of CLC/SEC, CLI/SEI, CLV and CLD/SED, indexed by opcode >> 6
+static const uint8_t flag_bits[4] = {0x01, 0x04, 0x40, 0x08};
+
+/**
+ * Set N and Z of the shadow P from a result.
+ */
+static void set_nz(uint8_t value)
+{
+    shadow.p = (shadow.p & ~(FLAG_N | FLAG_Z)) | (value & FLAG_N) | (value ? 0 : FLAG_Z);
+}
+
+/**
+ * Store a known value into a shadow register, with its flags.
+ */
+static void load(uint8_t *target, uint8_t bit, uint8_t value)
+{
+    *target = value;
+    shadow_valid |= bit;
+    set_nz(value);
+}
+
+/**
+ * Copy a shadow register into another if it is known, otherwise mark the
+ * target and its flags unknown.
+ */
+static void transfer(uint8_t *target, uint8_t bit, uint8_t value, uint8_t source_bit)
+{
+    if (shadow_valid & source_bit)
+    {
+        load(target, bit, value);
+    }
+    else
+    {
+        shadow_valid &= ~(bit | SHADOW_P);
+    }
+}
+
+/**
+ * Stop following and forget the shadow.
+ */
+void clear_shadow(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        shadow_valid = 0;
+        shadow_class = SH_NONE;
+    }
+}
+
+/**
+ * Start following the registers. Nothing is known until it is seen on
+ * the bus or read by injection.
+ */
+void start_shadow(void)
+{
+    clear_shadow();
+    shadow_enabled = 1;
+}
+
+/**
+ * Stop following the registers.
+ */
+void stop_shadow(void)
+{
+    shadow_enabled = 0;
+    clear_shadow();
+}
+
+/**
+ * Apply the completed instruction to the shadow. Called once per
+ * instruction, on the next opcode fetch or when the shadow is read.
+ */
+void commit_shadow(void)
+{
+    switch (shadow_class)
+    {
+    case SH_FLAGS:
+        shadow_valid &= ~SHADOW_P;
+        break;
+
+    case SH_ALU_A:
+        shadow_valid &= ~(SHADOW_A | SHADOW_P);
+        break;
+
+    case SH_LOAD_A:
+        load(&shadow.a, SHADOW_A, shadow_read);
+        break;
+
+    case SH_LOAD_X:
+        load(&shadow.x, SHADOW_X, shadow_read);
+        break;
+
+    case SH_LOAD_Y:
+        load(&shadow.y, SHADOW_Y, shadow_read);
+        break;
+
+    case SH_STORE_A:
+        shadow.a = shadow_write;
+        shadow_valid |= SHADOW_A;
+        break;
+
+    case SH_STORE_X:
+        shadow.x = shadow_write;
+        shadow_valid |= SHADOW_X;
+        break;
+
+    case SH_STORE_Y:
+        shadow.y = shadow_write;
+        shadow_valid |= SHADOW_Y;
+        break;
+
+    case SH_PUSH_A:
+        shadow.a = shadow_write;
+        shadow_valid |= SHADOW_A;
+        break;
+
+    case SH_PUSH_X:
+        shadow.x = shadow_write;
+        shadow_valid |= SHADOW_X;
+        break;
+
+    case SH_PUSH_Y:
+        shadow.y = shadow_write;
+        shadow_valid |= SHADOW_Y;
+        break;
+
+    case SH_PUSH_P:
+        shadow.p = shadow_write;
+        shadow_valid |= SHADOW_P;
+        break;
+
+    case SH_PULL_A:
+        load(&shadow.a, SHADOW_A, shadow_read);
+        break;
+
+    case SH_PULL_X:
+        load(&shadow.x, SHADOW_X, shadow_read);
+        break;
+
+    case SH_PULL_Y:
+        load(&shadow.y, SHADOW_Y, shadow_read);
+        break;
+
+    case SH_PULL_P:
+        shadow.p = shadow_read | FLAG_PUSHED;
+        shadow_valid |= SHADOW_P;
+        break;
+
+    case SH_RTI:
+        shadow_valid &= ~SHADOW_P;
+        break;
+
+    case SH_INTERRUPT:
+        // The last write pushed P; then I is set and D cleared
+        shadow.p = (shadow_write | FLAG_PUSHED | 0x04) & ~0x08;
+        shadow_valid |= SHADOW_P;
+        break;
+
+    case SH_TAX:
+        transfer(&shadow.x, SHADOW_X, shadow.a, SHADOW_A);
+        break;
+
+    case SH_TAY:
+        transfer(&shadow.y, SHADOW_Y, shadow.a, SHADOW_A);
+        break;
+
+    case SH_TXA:
+        transfer(&shadow.a, SHADOW_A, shadow.x, SHADOW_X);
+        break;
+
+    case SH_TYA:
+        transfer(&shadow.a, SHADOW_A, shadow.y, SHADOW_Y);
+        break;
+
+    case SH_TSX:
+        transfer(&shadow.x, SHADOW_X, shadow.sp, SHADOW_SP);
+        break;
+
+    case SH_TXS:
+        // No flags, and no bus traffic to read SP from
+        shadow.sp = shadow.x;
+        shadow_valid = (shadow_valid & ~SHADOW_SP) | ((shadow_valid & SHADOW_X) ? SHADOW_SP : 0);
+        break;
+
+    case SH_INX:
+        transfer(&shadow.x, SHADOW_X, shadow.x + 1, SHADOW_X);
+        break;
+
+    case SH_DEX:
+        transfer(&shadow.x, SHADOW_X, shadow.x - 1, SHADOW_X);
+        break;
+
+    case SH_INY:
+        transfer(&shadow.y, SHADOW_Y, shadow.y + 1, SHADOW_Y);
+        break;
+
+    case SH_DEY:
+        transfer(&shadow.y, SHADOW_Y, shadow.y - 1, SHADOW_Y);
+        break;
+
+    case SH_FLAG:
+    {
+        uint8_t bit = flag_bits[shadow_opcode >> 6];
+
+        if ((shadow_opcode & 0x20) && shadow_opcode != 0xB8) // CLV has no set
+        {
+            shadow.p |= bit;
+        }
+        else
+        {
+            shadow.p &= ~bit;
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    // Every instruction that touches the stack leaves SP at its last access
+    if (shadow_class >= SH_PUSH_A && shadow_class <= SH_INTERRUPT)
+    {
+        shadow.sp = shadow_stack;
+        shadow_valid |= SHADOW_SP;
+    }
+
+    shadow_class = SH_NONE;
+}
+
+/**
+ * Make the shadow match registers read or written by injection.
+ */
+void set_shadow(const registers_t *registers)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        shadow = *registers;
+        shadow.p |= FLAG_PUSHED;
+        shadow_valid = SHADOW_ALL;
+        shadow_class = SH_NONE;
+    }
+}
+
+/**
+ * Read the registers from the shadow, without touching the bus. The CPU
+ * must be halted before an opcode fetch, whose address is the PC.
+ * Returns 1 if successful, 0 if the shadow is off or not fully known.
+ */
+uint8_t read_shadow(registers_t *registers)
+{
+    if (!shadow_enabled || cpu_running || !(CONTROL_PIN & (1 << CPU_SYNC)))
+    {
+        return 0;
+    }
+
+    commit_shadow();
+
+    if (shadow_valid != SHADOW_ALL)
+    {
+        return 0;
+    }
+
+    *registers = shadow;
+    registers->pc = ((uint16_t)ADDR_BUS_HIGH << 8) | ADDR_BUS_LOW;
+    return 1;
+}
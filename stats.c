@@ -0,0 +1,48 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Bus performance counters.
+ */
+
+#include <avr/io.h>
+#include <string.h>
+#include <util/atomic.h>
+
+#include "cpu.h"
+#include "stats.h"
+
+// Global variables
+uint32_t stats[STATS_COUNTERS];
+uint8_t stats_incomplete = 0;
+static uint32_t stats_cycle_base; // Cycle counter at the last reset
+
+/**
+ * Zero all counters. The cycle counter itself keeps running, as the
+ * trace timestamps are taken from it.
+ */
+void reset_stats(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memset(stats, 0, sizeof(stats));
+        stats_incomplete = 0;
+        stats_cycle_base = cycle_count;
+    }
+}
+
+/**
+ * Take a consistent snapshot of the counters (STATS_COUNTERS entries).
+ */
+void read_stats(uint32_t *copy)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        memcpy(copy, stats, sizeof(stats));
+        copy[STAT_CYCLES] = cycle_count - stats_cycle_base;
+
+        if (stats_incomplete)
+        {
+            copy[STAT_INSTRUCTIONS] = STAT_UNAVAILABLE;
+        }
+    }
+}
@@ -0,0 +1,88 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Instruction trace control and download.
+ */
+
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "trace.h"
+
+#define TRACE_MASK      (TRACE_SIZE - 1)
+
+// Global variables
+volatile uint8_t trace_enabled = 0;
+uint16_t trace_pc[TRACE_SIZE];              // PC of each opcode fetch
+uint8_t trace_opcode[TRACE_SIZE];           // Opcode fetched
+uint16_t trace_time[TRACE_SIZE];            // Cycle counter, low 16 bits
+uint8_t trace_head = 0;                     // Next entry to write
+uint8_t trace_count = 0;                    // Valid entries, up to TRACE_SIZE
+static uint32_t trace_stop_cycle;           // Cycle counter when recording stopped
+
+/**
+ * Clear the trace buffer and start recording.
+ */
+void start_trace(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        trace_head = 0;
+        trace_count = 0;
+        trace_enabled = 1;
+    }
+}
+
+/**
+ * Stop recording and note the cycle counter for the download.
+ */
+void stop_trace(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        trace_enabled = 0;
+        trace_stop_cycle = cycle_count;
+    }
+}
+
+/**
+ * Return the size in bytes of the trace download.
+ */
+uint16_t trace_length(void)
+{
+    return TRACE_HEADER + 5 * trace_count;
+}
+
+/**
+ * Return one byte of the trace download (see trace.h for the layout).
+ * Only valid while recording is stopped.
+ */
+uint8_t trace_byte(uint16_t offset)
+{
+    uint8_t first = (trace_head - trace_count) & TRACE_MASK;
+
+    if (offset < TRACE_HEADER)
+    {
+        return offset ? trace_stop_cycle >> (8 * (TRACE_HEADER - 1 - offset)) : trace_count;
+    }
+
+    offset -= TRACE_HEADER;
+
+    if (offset < 2 * trace_count)
+    {
+        uint16_t pc = trace_pc[(first + offset / 2) & TRACE_MASK];
+        return offset & 1 ? pc & 0xFF : pc >> 8;
+    }
+
+    offset -= 2 * trace_count;
+
+    if (offset < trace_count)
+    {
+        return trace_opcode[(first + offset) & TRACE_MASK];
+    }
+
+    offset -= trace_count;
+
+    uint16_t time = trace_time[(first + offset / 2) & TRACE_MASK];
+    return offset & 1 ? time & 0xFF : time >> 8;
+}
@@ -0,0 +1,116 @@
+/*
+ * 6502 Emulator Interface using ATmega2560
+ *
+ * Incremental decoder for compressed loads. Bytes are fed one at a time
+ * as they arrive, so a token may span several calls; framed loads carry
+ * whole tokens and restart the decoder for each frame. Copies read back
+ * from 6502 memory, so they may reach into data loaded by earlier frames.
+ */
+
+#include <avr/io.h>
+
+#include "memory.h"
+#include "unpack.h"
+
+// Decoder states
+#define STATE_TOKEN         0
+#define STATE_LITERAL       1
+#define STATE_FILL          2
+#define STATE_DISTANCE_HIGH 3
+#define STATE_DISTANCE_LOW  4
+
+// Global variables
+static uint16_t unpack_address;             // Next address to write
+static uint16_t unpack_distance;            // Distance of the copy being decoded
+static uint8_t unpack_count;                // Bytes left in the literal, fill or copy
+static uint8_t state = STATE_TOKEN;         // Decoder state
+
+/**
+ * Start decoding a stream into 6502 memory at the given address.
+ */
+void unpack_begin(uint16_t address)
+{
+    unpack_address = address;
+    state = STATE_TOKEN;
+}
+
+/**
+ * Decode one byte of the stream.
+ * Returns 1 on success, 0 if the stream writes or copies from an
+ * invalid address. The decoder must be restarted after an error.
+ */
+uint8_t unpack_byte(uint8_t data)
+{
+    switch (state)
+    {
+    case STATE_TOKEN:
+        if (data < UNPACK_FILL)
+        {
+            unpack_count = data + 1;
+            state = STATE_LITERAL;
+        }
+        else
+        {
+            unpack_count = (data & 0x3F) + UNPACK_MIN_RUN;
+            state = data < UNPACK_COPY ? STATE_FILL : STATE_DISTANCE_HIGH;
+        }
+        return 1;
+
+    case STATE_LITERAL:
+        if (--unpack_count == 0)
+        {
+            state = STATE_TOKEN;
+        }
+        return write_memory(unpack_address++, data);
+
+    case STATE_FILL:
+        state = STATE_TOKEN;
+
+        do
+        {
+            if (!write_memory(unpack_address++, data))
+            {
+                return 0;
+            }
+        } while (--unpack_count);
+        return 1;
+
+    case STATE_DISTANCE_HIGH:
+        unpack_distance = (uint16_t)data << 8;
+        state = STATE_DISTANCE_LOW;
+        return 1;
+
+    case STATE_DISTANCE_LOW:
+        unpack_distance |= data;
+        state = STATE_TOKEN;
+
+        if (!unpack_distance)
+        {
+            return 0;
+        }
+
+        // Byte by byte, so an overlapping copy repeats a pattern
+        do
+        {
+            uint8_t value;
+
+            if (!read_memory(unpack_address - unpack_distance, &value) ||
+                !write_memory(unpack_address, value))
+            {
+                return 0;
+            }
+            unpack_address++;
+        } while (--unpack_count);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Return 1 if the decoder is between tokens, 0 if a token is incomplete.
+ */
+uint8_t unpack_idle(void)
+{
+    return state == STATE_TOKEN;
+}